@@ -1,6 +1,8 @@
 #include "Application.h"
 #include "imgui.h"
 #include "VectorUtils.h"
+#include "SceneFile.h"
+#include "Profiler.h"
 
 #include <chrono>
 
@@ -11,30 +13,9 @@ Application::Application()
 	camera(gfx.GetWidth(), gfx.GetHeight(), 45.0f, 0.1f, 100.0f)
 {
 	wnd.BindInputState(pInputState);
+	gfx.SetTextureClearColor(renderer.GetClearColor());
 
-	Material& orangeSphere = scene.materials.emplace_back();
-	orangeSphere.Albedo = { 1.0f, 0.55f, 0.0f, 1.0f };
-	orangeSphere.Roughness = 0.0f;
-
-	Material& blueSphere = scene.materials.emplace_back();
-	blueSphere.Albedo = { 0.2f, 0.3f, 1.0f, 1.0f };
-	blueSphere.Roughness = 0.1f;
-
-	{
-		Sphere sphere;
-		sphere.position = { 0.0f, 0.0f, 0.0f };
-		sphere.radius = 1.0f;
-		sphere.materialIndex = 0;
-		scene.spheres.push_back(sphere);
-	}
-
-	{
-		Sphere sphere;
-		sphere.position = { 0.0f, 101.0f, 0.0f };
-		sphere.radius = 100.0f;
-		sphere.materialIndex = 1;
-		scene.spheres.push_back(sphere);
-	}
+	scene = DefaultSceneDescription().scene;
 }
 
 int Application::Run()
@@ -110,16 +91,17 @@ void Application::OnUpdate(float dt)
 	}
 
 	if (camera.Update()) {
-		renderer.ResetFrameIndex();
+		renderer.OnCameraMoved();
 	}
 }
 
 void Application::OnRender()
 {
+	PROFILE_ZONE("Frame");
 	gfx.BeginFrame();
 
 	OnRenderUI();
-	renderer.Render(gfx, scene, camera);
+	renderer.Render(gfx.GetFramebuffer(), scene, camera);
 
 	gfx.EndFrame();
 }
@@ -127,12 +109,18 @@ void Application::OnRender()
 void Application::OnRenderUI()
 {
 	ImGui::Begin("Scene");
+	// Widgets edit copies, which go back through the Scene edit API so the renderer
+	// sees exactly which spheres and materials changed.
 	for (size_t i = 0; i < scene.spheres.size(); ++i) {
 		ImGui::PushID((int)i);
 
-		ImGui::DragFloat3("Position", &scene.spheres[i].position.x, 0.1f);
-		ImGui::DragFloat("Radius", &scene.spheres[i].radius, 0.1f);
-		ImGui::DragInt("Material ID", &scene.spheres[i].materialIndex, 1.0f, 0, (int)scene.materials.size() - 1);
+		Sphere sphere = scene.spheres[i];
+		bool changed = ImGui::DragFloat3("Position", &sphere.position.x, 0.1f);
+		changed |= ImGui::DragFloat("Radius", &sphere.radius, 0.1f);
+		changed |= ImGui::DragInt("Material ID", &sphere.materialIndex, 1.0f, 0, (int)scene.materials.size() - 1);
+		if (changed) {
+			scene.SetSphere((uint32_t)i, sphere);
+		}
 
 		ImGui::Separator();
 
@@ -143,9 +131,14 @@ void Application::OnRenderUI()
 	for (size_t i = 0; i < scene.materials.size(); ++i) {
 		ImGui::PushID((int)i);
 
-		ImGui::ColorEdit4("Albedo", &scene.materials[i].Albedo.x);
-		ImGui::DragFloat("Roughness", &scene.materials[i].Roughness, 0.005f, 0.0f, 1.0f);
-		ImGui::DragFloat("Mettalic", &scene.materials[i].Metallic, 0.005f, 0.0f, 1.0f);
+		Material material = scene.materials[i];
+		bool changed = ImGui::ColorEdit4("Albedo", &material.Albedo.x);
+		changed |= ImGui::DragFloat("Roughness", &material.Roughness, 0.005f, 0.0f, 1.0f);
+		changed |= ImGui::DragFloat("Mettalic", &material.Metallic, 0.005f, 0.0f, 1.0f);
+		changed |= ImGui::ColorEdit3("Emission", &material.Emission.x, ImGuiColorEditFlags_HDR | ImGuiColorEditFlags_Float);
+		if (changed) {
+			scene.SetMaterial((uint32_t)i, material);
+		}
 
 		ImGui::Separator();
 
@@ -24,7 +24,7 @@ private:
 	bool running = true;
 	Window wnd;
 	Graphics gfx{ wnd };
-	Renderer renderer{ gfx };
+	Renderer renderer{ gfx.GetWidth(), gfx.GetHeight() };
 	Camera camera;
 	Timer timer;
 	Scene scene;
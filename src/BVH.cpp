@@ -0,0 +1,570 @@
+#include "BVH.h"
+#include "Bounds.h"
+#include "Intersection.h"
+#include "VectorUtils.h"
+
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <bit>
+
+using namespace DirectX;
+
+namespace
+{
+	inline Bounds SphereBounds(const Sphere& sphere) {
+		const float r = std::abs(sphere.radius);
+		return { { sphere.position.x - r, sphere.position.y - r, sphere.position.z - r },
+			{ sphere.position.x + r, sphere.position.y + r, sphere.position.z + r } };
+	}
+
+	inline bool operator==(const XMFLOAT3& a, const XMFLOAT3& b) {
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	inline float Component(const XMFLOAT3& v, int axis) {
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+}
+
+void BVH::Build(const Scene& scene)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Clear();
+
+	const uint32_t nPrimitives = (uint32_t)scene.spheres.size();
+	if (nPrimitives == 0) {
+		return;
+	}
+
+	std::vector<BuildPrimitive> primitives(nPrimitives);
+	for (uint32_t i = 0; i < nPrimitives; ++i) {
+		const Sphere& sphere = scene.spheres[i];
+		const Bounds bounds = SphereBounds(sphere);
+		primitives[i].boundsMin = bounds.min;
+		primitives[i].boundsMax = bounds.max;
+		primitives[i].centroid = sphere.position;
+	}
+
+	m_Indices.resize(nPrimitives);
+	std::iota(m_Indices.begin(), m_Indices.end(), 0u);
+
+	m_Nodes.reserve(2 * (size_t)nPrimitives - 1);
+	m_Nodes.push_back({ {}, 0u, {}, nPrimitives });
+	m_Parents.reserve(m_Nodes.capacity());
+	m_Parents.push_back(UINT32_MAX);
+	UpdateBounds(0, primitives);
+
+	struct StackEntry {
+		uint32_t node;
+		uint32_t depth;
+	};
+	std::vector<StackEntry> stack = { { 0u, 1u } };
+
+	while (!stack.empty()) {
+		const auto [nodeIndex, depth] = stack.back();
+		stack.pop_back();
+
+		m_BuildStats.maxDepth = std::max(m_BuildStats.maxDepth, depth);
+
+		const Node node = m_Nodes[nodeIndex];
+		if (node.count <= 1) {
+			continue;
+		}
+
+		const Split split = depth < medianSplitDepth ? FindSplit(node, primitives) : Split{};
+		const float leafCost = LeafCost(node.count) * Bounds{ node.boundsMin, node.boundsMax }.Area();
+		if (node.count <= maxLeafSize && (split.axis < 0 || split.cost >= leafCost)) {
+			continue;
+		}
+
+		auto first = m_Indices.begin() + node.leftFirst;
+		auto last = first + node.count;
+		auto middle = first;
+		if (split.axis >= 0) {
+			middle = std::partition(first, last, [&](uint32_t i) {
+				return split.BinIndex(primitives[i].centroid) <= split.bin;
+			});
+		}
+		else {
+			// No usable SAH plane (coincident centroids or tree too deep): median split on the widest axis.
+			Bounds centroidBounds;
+			for (auto it = first; it != last; ++it) {
+				centroidBounds.Grow(primitives[*it].centroid);
+			}
+			const XMFLOAT3 extent = Utils::Subtract(centroidBounds.max, centroidBounds.min);
+			const int axis = extent.x > extent.y && extent.x > extent.z ? 0 : (extent.y > extent.z ? 1 : 2);
+			middle = first + node.count / 2;
+			std::nth_element(first, middle, last, [&](uint32_t l, uint32_t r) {
+				return Component(primitives[l].centroid, axis) < Component(primitives[r].centroid, axis);
+			});
+		}
+
+		const uint32_t leftCount = (uint32_t)(middle - first);
+		const uint32_t leftIndex = (uint32_t)m_Nodes.size();
+
+		m_Nodes.push_back({ {}, node.leftFirst, {}, leftCount });
+		m_Nodes.push_back({ {}, node.leftFirst + leftCount, {}, node.count - leftCount });
+		m_Nodes[nodeIndex].leftFirst = leftIndex;
+		m_Nodes[nodeIndex].count = 0;
+		m_Parents.push_back(nodeIndex);
+		m_Parents.push_back(nodeIndex);
+
+		UpdateBounds(leftIndex, primitives);
+		UpdateBounds(leftIndex + 1, primitives);
+
+		stack.push_back({ leftIndex, depth + 1 });
+		stack.push_back({ leftIndex + 1, depth + 1 });
+	}
+
+	m_Spheres.Build(scene.spheres, m_Indices);
+
+	m_Leaves.resize(nPrimitives);
+	m_Slots.resize(nPrimitives);
+	const float rootArea = Bounds{ m_Nodes[0].boundsMin, m_Nodes[0].boundsMax }.Area();
+	for (uint32_t nodeIndex = 0; nodeIndex < (uint32_t)m_Nodes.size(); ++nodeIndex) {
+		const Node& node = m_Nodes[nodeIndex];
+		const float area = Bounds{ node.boundsMin, node.boundsMax }.Area();
+		const float relativeArea = rootArea > 0.0f ? area / rootArea : 1.0f;
+		if (node.count > 0) {
+			++m_BuildStats.leafCount;
+			m_BuildStats.maxLeafSize = std::max(m_BuildStats.maxLeafSize, node.count);
+			m_BuildStats.sahCost += relativeArea * LeafCost(node.count);
+			m_SahArea += area * LeafCost(node.count);
+			for (uint32_t slot = node.leftFirst; slot < node.leftFirst + node.count; ++slot) {
+				m_Leaves[slot] = nodeIndex;
+				m_Slots[m_Indices[slot]] = slot;
+			}
+		}
+		else {
+			m_BuildStats.sahCost += relativeArea * traversalCost;
+			m_SahArea += area * traversalCost;
+		}
+	}
+	m_BuildStats.nodeCount = (uint32_t)m_Nodes.size();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_BuildStats.buildTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void BVH::Refit(const Scene& scene, const IndexRange& spheres)
+{
+	const uint32_t last = std::min(spheres.last, (uint32_t)m_Slots.size());
+	for (uint32_t i = spheres.first; i < last; ++i) {
+		const uint32_t slot = m_Slots[i];
+		m_Spheres.Set(slot, scene.spheres[i]);
+
+		// Children always follow their parent, so walking up ends at the root. It
+		// stops early where a node's bounds come out unchanged.
+		for (uint32_t nodeIndex = m_Leaves[slot]; nodeIndex != UINT32_MAX; nodeIndex = m_Parents[nodeIndex]) {
+			Node& node = m_Nodes[nodeIndex];
+			Bounds bounds;
+			if (node.count > 0) {
+				for (uint32_t j = node.leftFirst; j < node.leftFirst + node.count; ++j) {
+					const Bounds sphereBounds = SphereBounds(scene.spheres[m_Indices[j]]);
+					bounds.Grow(sphereBounds);
+				}
+			}
+			else {
+				bounds.Grow(m_Nodes[node.leftFirst].boundsMin, m_Nodes[node.leftFirst].boundsMax);
+				bounds.Grow(m_Nodes[node.leftFirst + 1].boundsMin, m_Nodes[node.leftFirst + 1].boundsMax);
+			}
+			if (bounds.min == node.boundsMin && bounds.max == node.boundsMax) {
+				break;
+			}
+			const float nodeCost = node.count > 0 ? LeafCost(node.count) : traversalCost;
+			m_SahArea += (double)(bounds.Area() - Bounds{ node.boundsMin, node.boundsMax }.Area()) * nodeCost;
+			node.boundsMin = bounds.min;
+			node.boundsMax = bounds.max;
+		}
+	}
+}
+
+void BVH::Clear() noexcept
+{
+	m_Nodes.clear();
+	m_Indices.clear();
+	m_Parents.clear();
+	m_Leaves.clear();
+	m_Slots.clear();
+	m_SahArea = 0.0;
+	m_Spheres.Clear();
+	m_BuildStats = {};
+}
+
+bool BVH::Empty() const noexcept
+{
+	return m_Nodes.empty();
+}
+
+int BVH::Intersect(const Ray& ray, float& hitDistance, TraversalStats* stats) const
+{
+	if (m_Nodes.empty()) {
+		return -1;
+	}
+
+	const XMFLOAT3 invDirection = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+
+	uint64_t nodesVisited = 0;
+	uint64_t spheresTested = 0;
+	int closest = -1;
+
+	struct StackEntry {
+		uint32_t node;
+		float tEntry;
+	};
+	StackEntry stack[maxTreeDepth];
+	uint32_t stackSize = 0;
+	uint32_t nodeIndex = 0;
+
+	if (Utils::IntersectAABB(ray.origin, invDirection, m_Nodes[0].boundsMin, m_Nodes[0].boundsMax, hitDistance) == INFINITY) {
+		nodeIndex = UINT32_MAX;
+	}
+
+	while (nodeIndex != UINT32_MAX) {
+		const Node& node = m_Nodes[nodeIndex];
+		++nodesVisited;
+
+		if (node.count > 0) {
+			const int hit = m_Spheres.Intersect(ray, hitDistance, node.leftFirst, node.count);
+			if (hit >= 0) {
+				closest = (int)m_Indices[hit];
+			}
+			spheresTested += node.count;
+		}
+		else {
+			const Node& left = m_Nodes[node.leftFirst];
+			const Node& right = m_Nodes[node.leftFirst + 1];
+			float tLeft = Utils::IntersectAABB(ray.origin, invDirection, left.boundsMin, left.boundsMax, hitDistance);
+			float tRight = Utils::IntersectAABB(ray.origin, invDirection, right.boundsMin, right.boundsMax, hitDistance);
+			uint32_t nearChild = node.leftFirst;
+			uint32_t farChild = node.leftFirst + 1;
+			if (tRight < tLeft) {
+				std::swap(tLeft, tRight);
+				std::swap(nearChild, farChild);
+			}
+
+			if (tLeft != INFINITY) {
+				if (tRight != INFINITY) {
+					stack[stackSize++] = { farChild, tRight };
+				}
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		// Pop the next candidate, skipping nodes that can no longer beat the current hit.
+		nodeIndex = UINT32_MAX;
+		while (stackSize > 0) {
+			const StackEntry& candidate = stack[--stackSize];
+			if (candidate.tEntry < hitDistance) {
+				nodeIndex = candidate.node;
+				break;
+			}
+		}
+	}
+
+	if (stats) {
+		++stats->rays;
+		stats->nodesVisited += nodesVisited;
+		stats->spheresTested += spheresTested;
+	}
+
+	return closest;
+}
+
+bool BVH::Occluded(const Ray& ray, float tMax, TraversalStats* stats) const
+{
+	if (m_Nodes.empty()) {
+		return false;
+	}
+
+	const XMFLOAT3 invDirection = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+
+	uint64_t nodesVisited = 0;
+	uint64_t spheresTested = 0;
+	bool occluded = false;
+
+	uint32_t stack[maxTreeDepth];
+	uint32_t stackSize = 0;
+	uint32_t nodeIndex = 0;
+
+	if (Utils::IntersectAABB(ray.origin, invDirection, m_Nodes[0].boundsMin, m_Nodes[0].boundsMax, tMax) == INFINITY) {
+		nodeIndex = UINT32_MAX;
+	}
+
+	// Near child first as in Intersect, since nearby spheres are the likeliest
+	// blockers, but nothing is culled by distance: any hit ends the query.
+	while (nodeIndex != UINT32_MAX) {
+		const Node& node = m_Nodes[nodeIndex];
+		++nodesVisited;
+
+		if (node.count > 0) {
+			spheresTested += node.count;
+			if (m_Spheres.Occluded(ray, tMax, node.leftFirst, node.count)) {
+				occluded = true;
+				break;
+			}
+		}
+		else {
+			const Node& left = m_Nodes[node.leftFirst];
+			const Node& right = m_Nodes[node.leftFirst + 1];
+			const float tLeft = Utils::IntersectAABB(ray.origin, invDirection, left.boundsMin, left.boundsMax, tMax);
+			const float tRight = Utils::IntersectAABB(ray.origin, invDirection, right.boundsMin, right.boundsMax, tMax);
+			const bool rightFirst = tRight < tLeft;
+			const uint32_t nearChild = rightFirst ? node.leftFirst + 1 : node.leftFirst;
+			const uint32_t farChild = rightFirst ? node.leftFirst : node.leftFirst + 1;
+
+			if (std::min(tLeft, tRight) != INFINITY) {
+				if (std::max(tLeft, tRight) != INFINITY) {
+					stack[stackSize++] = farChild;
+				}
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		nodeIndex = stackSize > 0 ? stack[--stackSize] : UINT32_MAX;
+	}
+
+	if (stats) {
+		++stats->rays;
+		stats->nodesVisited += nodesVisited;
+		stats->spheresTested += spheresTested;
+	}
+
+	return occluded;
+}
+
+void BVH::IntersectPacket(RayPacket& packet, TraversalStats* stats) const
+{
+	using namespace Simd;
+
+	if (m_Nodes.empty()) {
+		return;
+	}
+
+	alignas(32) float invDirectionX[RayPacket::maxSize];
+	alignas(32) float invDirectionY[RayPacket::maxSize];
+	alignas(32) float invDirectionZ[RayPacket::maxSize];
+	for (uint32_t i = 0; i < RayPacket::maxSize; ++i) {
+		invDirectionX[i] = 1.0f / packet.directionX[i];
+		invDirectionY[i] = 1.0f / packet.directionY[i];
+		invDirectionZ[i] = 1.0f / packet.directionZ[i];
+	}
+
+	const Float zero = Broadcast(0.0f);
+
+	// Returns the subset of groupMask with at least one ray entering the node before its current hit.
+	auto testNode = [&](const Node& node, uint64_t groupMask) {
+		// Slab offsets relative to the shared origin are the same for every ray.
+		const Float minX = Broadcast(node.boundsMin.x - packet.origin.x);
+		const Float minY = Broadcast(node.boundsMin.y - packet.origin.y);
+		const Float minZ = Broadcast(node.boundsMin.z - packet.origin.z);
+		const Float maxX = Broadcast(node.boundsMax.x - packet.origin.x);
+		const Float maxY = Broadcast(node.boundsMax.y - packet.origin.y);
+		const Float maxZ = Broadcast(node.boundsMax.z - packet.origin.z);
+
+		uint64_t result = 0;
+		for (uint64_t groups = groupMask; groups != 0; groups &= groups - 1) {
+			const uint32_t group = (uint32_t)std::countr_zero(groups);
+			const uint32_t lane = group * width;
+
+			const Float invX = Load(&invDirectionX[lane]);
+			const Float invY = Load(&invDirectionY[lane]);
+			const Float invZ = Load(&invDirectionZ[lane]);
+
+			const Float tx1 = minX * invX, tx2 = maxX * invX;
+			const Float ty1 = minY * invY, ty2 = maxY * invY;
+			const Float tz1 = minZ * invZ, tz2 = maxZ * invZ;
+			const Float tNear = Max(Max(Min(tx1, tx2), Min(ty1, ty2)), Min(tz1, tz2));
+			const Float tFar = Min(Min(Max(tx1, tx2), Max(ty1, ty2)), Max(tz1, tz2));
+
+			const Mask hit = (tNear <= tFar) & (zero <= tFar) & (tNear < Load(&packet.hitDistance[lane]));
+			if (Any(hit)) {
+				result |= 1ull << group;
+			}
+		}
+		return result;
+	};
+
+	auto distanceToOrigin = [&](const Node& node) {
+		const XMFLOAT3 center = {
+			0.5f * (node.boundsMin.x + node.boundsMax.x) - packet.origin.x,
+			0.5f * (node.boundsMin.y + node.boundsMax.y) - packet.origin.y,
+			0.5f * (node.boundsMin.z + node.boundsMax.z) - packet.origin.z
+		};
+		return Utils::Dot(center, center);
+	};
+
+	struct StackEntry {
+		uint32_t node;
+		uint64_t groupMask;
+	};
+	StackEntry stack[maxTreeDepth];
+	uint32_t stackSize = 0;
+
+	uint64_t nodesVisited = 0;
+	uint64_t spheresTested = 0;
+
+	uint32_t nodeIndex = 0;
+	uint64_t groupMask = testNode(m_Nodes[0], packet.GroupMask());
+
+	while (true) {
+		if (groupMask != 0) {
+			const Node& node = m_Nodes[nodeIndex];
+			++nodesVisited;
+			if (node.count > 0) {
+				m_Spheres.IntersectPacket(packet, node.leftFirst, node.count, groupMask);
+				spheresTested += (uint64_t)node.count * std::popcount(groupMask) * Simd::width;
+			}
+			else {
+				// Rays share an origin, so the child whose center is closer to it is a good near-first guess for all of them.
+				uint32_t nearChild = node.leftFirst;
+				uint32_t farChild = node.leftFirst + 1;
+				if (distanceToOrigin(m_Nodes[farChild]) < distanceToOrigin(m_Nodes[nearChild])) {
+					std::swap(nearChild, farChild);
+				}
+
+				const uint64_t nearMask = testNode(m_Nodes[nearChild], groupMask);
+				const uint64_t farMask = testNode(m_Nodes[farChild], groupMask);
+				if (farMask != 0) {
+					stack[stackSize++] = { farChild, farMask };
+				}
+				if (nearMask != 0) {
+					nodeIndex = nearChild;
+					groupMask = nearMask;
+					continue;
+				}
+			}
+		}
+
+		if (stackSize == 0) {
+			break;
+		}
+
+		// Hit distances may have shrunk since the node was pushed; re-test before descending.
+		const StackEntry& entry = stack[--stackSize];
+		nodeIndex = entry.node;
+		groupMask = testNode(m_Nodes[nodeIndex], entry.groupMask);
+	}
+
+	for (uint32_t i = 0; i < packet.count; ++i) {
+		if (packet.objectIndex[i] >= 0) {
+			packet.objectIndex[i] = (int32_t)m_Indices[packet.objectIndex[i]];
+		}
+	}
+
+	if (stats) {
+		stats->rays += packet.count;
+		stats->nodesVisited += nodesVisited;
+		stats->spheresTested += spheresTested;
+	}
+}
+
+const BVH::BuildStats& BVH::GetBuildStats() const noexcept
+{
+	return m_BuildStats;
+}
+
+float BVH::GetSahCost() const noexcept
+{
+	if (m_Nodes.empty()) {
+		return 0.0f;
+	}
+	const float rootArea = Bounds{ m_Nodes[0].boundsMin, m_Nodes[0].boundsMax }.Area();
+	return rootArea > 0.0f ? (float)(m_SahArea / rootArea) : m_BuildStats.sahCost;
+}
+
+void BVH::UpdateBounds(uint32_t nodeIndex, const std::vector<BuildPrimitive>& primitives)
+{
+	Node& node = m_Nodes[nodeIndex];
+	Bounds bounds;
+	for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+		const BuildPrimitive& primitive = primitives[m_Indices[i]];
+		bounds.Grow(primitive.boundsMin, primitive.boundsMax);
+	}
+	node.boundsMin = bounds.min;
+	node.boundsMax = bounds.max;
+}
+
+int BVH::Split::BinIndex(const XMFLOAT3& centroid) const
+{
+	return std::clamp((int)((Component(centroid, axis) - centroidMin) * binScale), 0, nBins - 1);
+}
+
+float BVH::LeafCost(uint32_t count) noexcept
+{
+	return intersectionCost * (float)((count + SphereSoA::simdWidth - 1) / SphereSoA::simdWidth);
+}
+
+BVH::Split BVH::FindSplit(const Node& node, const std::vector<BuildPrimitive>& primitives) const
+{
+	Bounds centroidBounds;
+	for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+		centroidBounds.Grow(primitives[m_Indices[i]].centroid);
+	}
+
+	struct Bin {
+		Bounds bounds;
+		uint32_t count = 0;
+	};
+
+	const float nodeArea = Bounds{ node.boundsMin, node.boundsMax }.Area();
+	Split best;
+
+	for (int a = 0; a < 3; ++a) {
+		const float boundsMin = Component(centroidBounds.min, a);
+		const float boundsMax = Component(centroidBounds.max, a);
+		if (boundsMax <= boundsMin) {
+			continue;
+		}
+
+		Split candidate;
+		candidate.axis = a;
+		candidate.centroidMin = boundsMin;
+		candidate.binScale = nBins / (boundsMax - boundsMin);
+
+		Bin bins[nBins];
+		for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+			const BuildPrimitive& primitive = primitives[m_Indices[i]];
+			Bin& bin = bins[candidate.BinIndex(primitive.centroid)];
+			bin.count++;
+			bin.bounds.Grow(primitive.boundsMin, primitive.boundsMax);
+		}
+
+		// Sweep from both sides to get area/count on each side of every candidate plane.
+		float leftArea[nBins - 1], rightArea[nBins - 1];
+		uint32_t leftCount[nBins - 1], rightCount[nBins - 1];
+		Bounds leftBounds, rightBounds;
+		uint32_t leftSum = 0, rightSum = 0;
+		for (int i = 0; i < nBins - 1; ++i) {
+			leftSum += bins[i].count;
+			leftCount[i] = leftSum;
+			leftBounds.Grow(bins[i].bounds);
+			leftArea[i] = leftBounds.Area();
+
+			rightSum += bins[nBins - 1 - i].count;
+			rightCount[nBins - 2 - i] = rightSum;
+			rightBounds.Grow(bins[nBins - 1 - i].bounds);
+			rightArea[nBins - 2 - i] = rightBounds.Area();
+		}
+
+		for (int i = 0; i < nBins - 1; ++i) {
+			if (leftCount[i] == 0 || rightCount[i] == 0) {
+				continue;
+			}
+			const float planeCost = traversalCost * nodeArea +
+				LeafCost(leftCount[i]) * leftArea[i] + LeafCost(rightCount[i]) * rightArea[i];
+			if (planeCost < best.cost) {
+				candidate.bin = i;
+				candidate.cost = planeCost;
+				best = candidate;
+			}
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Scene.h"
+#include "SphereSoA.h"
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include <math.h>
+
+// Bounding volume hierarchy over Scene::spheres, built with binned SAH.
+class BVH {
+public:
+	struct BuildStats {
+		float buildTime = 0.0f; // ms
+		uint32_t nodeCount = 0;
+		uint32_t leafCount = 0;
+		uint32_t maxDepth = 0;
+		uint32_t maxLeafSize = 0;
+		float sahCost = 0.0f;
+	};
+	struct TraversalStats {
+		uint64_t rays = 0;
+		uint64_t nodesVisited = 0;
+		uint64_t spheresTested = 0;
+	};
+public:
+	void Build(const Scene& scene);
+	// Moves the given spheres to their current place in the scene without changing
+	// the tree: bounds are updated from their leaves up to the root. The tree gets
+	// worse as spheres leave their neighbours behind; GetSahCost shows by how much.
+	void Refit(const Scene& scene, const IndexRange& spheres);
+	void Clear() noexcept;
+	bool Empty() const noexcept;
+	// Returns index into Scene::spheres of the closest hit or -1 on miss.
+	// hitDistance is in/out: only hits closer than its initial value are reported.
+	int Intersect(const Ray& ray, float& hitDistance, TraversalStats* stats = nullptr) const;
+	// Any-hit query: whether something is hit closer than tMax. Traversal ends at
+	// the first leaf with a hit and no hit point or sphere index is computed.
+	bool Occluded(const Ray& ray, float tMax, TraversalStats* stats = nullptr) const;
+	// Traverses the hierarchy once for the whole packet, descending into a node
+	// only for the SIMD lane groups whose rays enter it. The caller initializes
+	// packet.hitDistance/objectIndex to misses; hits report Scene::spheres indices.
+	// stats counts every lane of a tested SIMD group as a sphere test.
+	void IntersectPacket(RayPacket& packet, TraversalStats* stats = nullptr) const;
+	const BuildStats& GetBuildStats() const noexcept;
+	// SAH cost of the tree as it is now, equal to GetBuildStats().sahCost until a refit.
+	float GetSahCost() const noexcept;
+private:
+	struct Node {
+		DirectX::XMFLOAT3 boundsMin;
+		uint32_t leftFirst; // first child for inner nodes, first primitive for leaves
+		DirectX::XMFLOAT3 boundsMax;
+		uint32_t count; // 0 for inner nodes
+	};
+	struct BuildPrimitive {
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+		DirectX::XMFLOAT3 centroid;
+	};
+	struct Split {
+		int axis = -1;
+		int bin = 0;
+		float centroidMin = 0.0f;
+		float binScale = 0.0f;
+		float cost = INFINITY;
+		int BinIndex(const DirectX::XMFLOAT3& centroid) const;
+	};
+	void UpdateBounds(uint32_t nodeIndex, const std::vector<BuildPrimitive>& primitives);
+	Split FindSplit(const Node& node, const std::vector<BuildPrimitive>& primitives) const;
+	// Leaves are tested a SIMD group of spheres at a time.
+	static float LeafCost(uint32_t count) noexcept;
+private:
+	static constexpr int nBins = 16;
+	static constexpr uint32_t maxLeafSize = 8;
+	static constexpr uint32_t maxTreeDepth = 64; // also the traversal stack size
+	static constexpr uint32_t medianSplitDepth = 40; // below this SAH gives way to median splits to bound depth
+	static constexpr float traversalCost = 1.0f;
+	static constexpr float intersectionCost = 1.0f;
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_Indices;
+	// For refits
+	std::vector<uint32_t> m_Parents; // per node, UINT32_MAX at the root
+	std::vector<uint32_t> m_Leaves; // per primitive slot, the leaf holding it
+	std::vector<uint32_t> m_Slots; // per Scene::spheres index, its slot in m_Indices
+	double m_SahArea = 0.0; // SAH cost before dividing by the root's area
+	SphereSoA m_Spheres; // reordered so each leaf is a contiguous SIMD range
+	BuildStats m_BuildStats;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <math.h>
+
+// Axis-aligned box for hierarchy builders. A default box is empty: growing it
+// by anything yields that thing, and growing anything by it changes nothing.
+struct Bounds {
+	DirectX::XMFLOAT3 min = { INFINITY, INFINITY, INFINITY };
+	DirectX::XMFLOAT3 max = { -INFINITY, -INFINITY, -INFINITY };
+
+	void Grow(const DirectX::XMFLOAT3& p) {
+		Grow(p, p);
+	}
+	// Min and max grow separately, so an empty box's +INF/-INF corners are no-ops.
+	void Grow(const DirectX::XMFLOAT3& bMin, const DirectX::XMFLOAT3& bMax) {
+		min = { std::min(min.x, bMin.x), std::min(min.y, bMin.y), std::min(min.z, bMin.z) };
+		max = { std::max(max.x, bMax.x), std::max(max.y, bMax.y), std::max(max.z, bMax.z) };
+	}
+	void Grow(const Bounds& b) {
+		Grow(b.min, b.max);
+	}
+	bool Empty() const {
+		return min.x > max.x;
+	}
+	float Area() const {
+		if (Empty()) {
+			return 0.0f;
+		}
+		const DirectX::XMFLOAT3 e = { max.x - min.x, max.y - min.y, max.z - min.z };
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+};
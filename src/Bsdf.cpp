@@ -0,0 +1,174 @@
+#include "Bsdf.h"
+#include "VectorUtils.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// Below this alpha GGX is a mirror for every practical purpose, and D and its
+	// pdf start to overflow.
+	constexpr float minAlpha = 0.002f;
+	constexpr float dielectricF0 = 0.04f;
+
+	// Tangent frame around a unit normal; z is the normal.
+	struct Frame {
+		XMFLOAT3 tangent;
+		XMFLOAT3 bitangent;
+		XMFLOAT3 normal;
+
+		explicit Frame(const XMFLOAT3& n) : normal(n) {
+			Utils::OrthonormalBasis(n, tangent, bitangent);
+		}
+		XMFLOAT3 ToLocal(const XMFLOAT3& v) const {
+			return { Utils::Dot(v, tangent), Utils::Dot(v, bitangent), Utils::Dot(v, normal) };
+		}
+		XMFLOAT3 ToWorld(const XMFLOAT3& v) const {
+			return Utils::Add(Utils::Add(Utils::Scale(tangent, v.x), Utils::Scale(bitangent, v.y)), Utils::Scale(normal, v.z));
+		}
+	};
+
+	struct Lobes {
+		float alpha;
+		XMFLOAT3 f0;
+		XMFLOAT3 diffuse; // albedo / pi, already weighted by the base's share
+		float specularProbability;
+	};
+
+	XMFLOAT3 Schlick(const XMFLOAT3& f0, float cosTheta)
+	{
+		const float m = std::clamp(1.0f - cosTheta, 0.0f, 1.0f);
+		const float m5 = m * m * m * m * m;
+		return { f0.x + (1.0f - f0.x) * m5, f0.y + (1.0f - f0.y) * m5, f0.z + (1.0f - f0.z) * m5 };
+	}
+
+	// Lobes are picked in proportion to their reflectance seen from wo.
+	Lobes GetLobes(const Material& material, float cosThetaO)
+	{
+		const XMFLOAT3 albedo = Utils::ToFloat3(material.Albedo);
+		const float metallic = std::clamp(material.Metallic, 0.0f, 1.0f);
+		const float roughness = std::clamp(material.Roughness, 0.0f, 1.0f);
+
+		Lobes lobes;
+		lobes.alpha = std::max(roughness * roughness, minAlpha);
+		lobes.f0 = {
+			dielectricF0 + (albedo.x - dielectricF0) * metallic,
+			dielectricF0 + (albedo.y - dielectricF0) * metallic,
+			dielectricF0 + (albedo.z - dielectricF0) * metallic,
+		};
+		// The base sees what the dielectric coat transmits at normal incidence.
+		lobes.diffuse = Utils::Scale(albedo, (1.0f - metallic) * (1.0f - dielectricF0) / XM_PI);
+		const float specular = Utils::Luminance(Schlick(lobes.f0, cosThetaO));
+		const float diffuse = Utils::Luminance(lobes.diffuse) * XM_PI;
+		lobes.specularProbability = specular + diffuse > 0.0f ? specular / (specular + diffuse) : 1.0f;
+		return lobes;
+	}
+
+	// GGX normal distribution, with cosThetaH in the local frame.
+	float D(float alpha, float cosThetaH)
+	{
+		const float a2 = alpha * alpha;
+		const float d = cosThetaH * cosThetaH * (a2 - 1.0f) + 1.0f;
+		return a2 / (XM_PI * d * d);
+	}
+
+	// Smith Lambda for GGX.
+	float Lambda(float alpha, float cosTheta)
+	{
+		const float cos2 = cosTheta * cosTheta;
+		const float tan2 = std::max(1.0f - cos2, 0.0f) / cos2;
+		return 0.5f * (-1.0f + sqrtf(1.0f + alpha * alpha * tan2));
+	}
+
+	// Visible normal in the local frame (Heitz, "Sampling the GGX Distribution of
+	// Visible Normals", JCGT 2018).
+	XMFLOAT3 SampleVisibleNormal(float alpha, const XMFLOAT3& wo, float u1, float u2)
+	{
+		const XMFLOAT3 vh = Utils::Normalize({ alpha * wo.x, alpha * wo.y, wo.z });
+		const float lengthSq = vh.x * vh.x + vh.y * vh.y;
+		const XMFLOAT3 t1 = lengthSq > 0.0f ? Utils::Scale(XMFLOAT3{ -vh.y, vh.x, 0.0f }, 1.0f / sqrtf(lengthSq)) : XMFLOAT3{ 1.0f, 0.0f, 0.0f };
+		const XMFLOAT3 t2 = Utils::Cross(vh, t1);
+
+		const float r = sqrtf(u1);
+		const float phi = 2.0f * XM_PI * u2;
+		const float p1 = r * cosf(phi);
+		const float s = 0.5f * (1.0f + vh.z);
+		const float p2 = (1.0f - s) * sqrtf(std::max(1.0f - p1 * p1, 0.0f)) + s * r * sinf(phi);
+		const float p3 = sqrtf(std::max(1.0f - p1 * p1 - p2 * p2, 0.0f));
+
+		const XMFLOAT3 nh = Utils::Add(Utils::Add(Utils::Scale(t1, p1), Utils::Scale(t2, p2)), Utils::Scale(vh, p3));
+		return Utils::Normalize({ alpha * nh.x, alpha * nh.y, std::max(nh.z, 0.0f) });
+	}
+
+	XMFLOAT3 EvaluateLocal(const Lobes& lobes, const XMFLOAT3& wo, const XMFLOAT3& wi)
+	{
+		if (wo.z <= 0.0f || wi.z <= 0.0f) {
+			return { 0.0f, 0.0f, 0.0f };
+		}
+		const XMFLOAT3 h = Utils::Normalize(Utils::Add(wo, wi));
+		const XMFLOAT3 F = Schlick(lobes.f0, Utils::Dot(wi, h));
+		const float G2 = 1.0f / (1.0f + Lambda(lobes.alpha, wo.z) + Lambda(lobes.alpha, wi.z));
+		// The specular cos(wi) cancels against the 4 cos(wo) cos(wi) denominator.
+		const float specular = D(lobes.alpha, h.z) * G2 / (4.0f * wo.z);
+		return Utils::Add(Utils::Scale(F, specular), Utils::Scale(lobes.diffuse, wi.z));
+	}
+
+	float PdfLocal(const Lobes& lobes, const XMFLOAT3& wo, const XMFLOAT3& wi)
+	{
+		if (wo.z <= 0.0f || wi.z <= 0.0f) {
+			return 0.0f;
+		}
+		const XMFLOAT3 h = Utils::Normalize(Utils::Add(wo, wi));
+		// D_wo(h) / (4 wo.h), where D_wo(h) = G1(wo) max(wo.h, 0) D(h) / wo.z.
+		const float G1 = 1.0f / (1.0f + Lambda(lobes.alpha, wo.z));
+		const float specular = G1 * D(lobes.alpha, h.z) / (4.0f * wo.z);
+		const float diffuse = wi.z / XM_PI;
+		return lobes.specularProbability * specular + (1.0f - lobes.specularProbability) * diffuse;
+	}
+}
+
+XMFLOAT3 Bsdf::Evaluate(const Material& material, const XMFLOAT3& normal, const XMFLOAT3& wo, const XMFLOAT3& wi)
+{
+	const Frame frame(normal);
+	const XMFLOAT3 woLocal = frame.ToLocal(wo);
+	return EvaluateLocal(GetLobes(material, woLocal.z), woLocal, frame.ToLocal(wi));
+}
+
+float Bsdf::Pdf(const Material& material, const XMFLOAT3& normal, const XMFLOAT3& wo, const XMFLOAT3& wi)
+{
+	const Frame frame(normal);
+	const XMFLOAT3 woLocal = frame.ToLocal(wo);
+	return PdfLocal(GetLobes(material, woLocal.z), woLocal, frame.ToLocal(wi));
+}
+
+bool Bsdf::SampleDirection(const Material& material, const XMFLOAT3& normal, const XMFLOAT3& wo, const XMFLOAT3& u, Sample& sample)
+{
+	const Frame frame(normal);
+	const XMFLOAT3 woLocal = frame.ToLocal(wo);
+	if (woLocal.z <= 0.0f) {
+		return false;
+	}
+	const Lobes lobes = GetLobes(material, woLocal.z);
+
+	XMFLOAT3 wi;
+	if (u.z < lobes.specularProbability) {
+		const XMFLOAT3 h = SampleVisibleNormal(lobes.alpha, woLocal, u.x, u.y);
+		wi = Utils::Subtract(Utils::Scale(h, 2.0f * Utils::Dot(woLocal, h)), woLocal);
+	}
+	else {
+		// Cosine-weighted hemisphere: a uniform disk lifted onto it.
+		const float r = sqrtf(u.x);
+		const float phi = 2.0f * XM_PI * u.y;
+		wi = { r * cosf(phi), r * sinf(phi), sqrtf(std::max(1.0f - u.x, 0.0f)) };
+	}
+
+	sample.pdf = PdfLocal(lobes, woLocal, wi);
+	if (sample.pdf <= 0.0f) {
+		return false;
+	}
+	sample.direction = frame.ToWorld(wi);
+	sample.weight = Utils::Scale(EvaluateLocal(lobes, woLocal, wi), 1.0f / sample.pdf);
+	return true;
+}
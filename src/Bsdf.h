@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Scene.h"
+#include <DirectXMath.h>
+
+// The Albedo/Roughness/Metallic material model: a GGX specular layer with
+// Schlick Fresnel from F0 = lerp(0.04, albedo, metallic) over a Lambertian base
+// weighted by 1 - metallic. Directions point away from the surface; wo is
+// towards the viewer, wi towards the light or the next bounce.
+namespace Bsdf
+{
+	struct Sample {
+		DirectX::XMFLOAT3 direction; // wi, world space
+		DirectX::XMFLOAT3 weight; // f * cos / pdf
+		float pdf = 0.0f;
+	};
+
+	// f(wo, wi) * cos(normal, wi); zero below the surface.
+	DirectX::XMFLOAT3 Evaluate(const Material& material, const DirectX::XMFLOAT3& normal,
+		const DirectX::XMFLOAT3& wo, const DirectX::XMFLOAT3& wi);
+	// Solid-angle density with which SampleDirection returns wi.
+	float Pdf(const Material& material, const DirectX::XMFLOAT3& normal,
+		const DirectX::XMFLOAT3& wo, const DirectX::XMFLOAT3& wi);
+	// Picks the specular or diffuse lobe by their expected contribution, then
+	// samples GGX visible normals or the cosine. The pdf is that of the mixture,
+	// so the weight is low-variance whichever lobe was picked. u is three
+	// uniform numbers: a 2D direction (x, y), so a sampler's stratified pair
+	// lands on it, and the lobe choice (z). Returns false when the path ends
+	// here: a sample below the surface or a view from behind it.
+	bool SampleDirection(const Material& material, const DirectX::XMFLOAT3& normal,
+		const DirectX::XMFLOAT3& wo, const DirectX::XMFLOAT3& u, Sample& sample);
+}
@@ -1,5 +1,7 @@
 #include "Camera.h"
 #include "VectorUtils.h"
+#include "Simd.h"
+#include "Profiler.h"
 #include <algorithm>
 
 using namespace DirectX;
@@ -14,19 +16,44 @@ Camera::Camera(int width, int height, float fovAngleYDegrees, float nearClip, fl
 	m_Position(XMVectorSet(0.0f, 0.0f, -6.0f, 1.0f))
 {
 	aspectRatio = (float)m_Width / (float)m_Height;
-	rayDirections.resize(m_Width * m_Height);
 
 	m_forwardDir = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
 	m_rightDir = XMVector3Normalize(XMVector3Cross(m_forwardDir, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
 
 	RecalculateProjection();
 	RecalculateView();
-	RecalculateRayDirections();
+	RecalculateRayGenerator();
 }
 
-const std::vector<DirectX::XMFLOAT3>& Camera::GetRayDirections() const noexcept
+const Camera::RayGenerator& Camera::GetRayGenerator() const noexcept
 {
-	return rayDirections;
+	return rayGenerator;
+}
+
+DirectX::XMFLOAT3 Camera::RayGenerator::GetDirection(float x, float y) const noexcept
+{
+	return Utils::Normalize(Utils::Add(corner, Utils::Add(Utils::Scale(dx, x), Utils::Scale(dy, y))));
+}
+
+void Camera::RayGenerator::GetDirections(const float* x, const float* y, uint32_t count, float* outX, float* outY, float* outZ) const noexcept
+{
+	using namespace Simd;
+
+	const Float cornerX = Broadcast(corner.x), cornerY = Broadcast(corner.y), cornerZ = Broadcast(corner.z);
+	const Float dxX = Broadcast(dx.x), dxY = Broadcast(dx.y), dxZ = Broadcast(dx.z);
+	const Float dyX = Broadcast(dy.x), dyY = Broadcast(dy.y), dyZ = Broadcast(dy.z);
+
+	for (uint32_t i = 0; i < count; i += width) {
+		const Float px = Load(x + i);
+		const Float py = Load(y + i);
+		const Float dirX = cornerX + dxX * px + dyX * py;
+		const Float dirY = cornerY + dxY * px + dyY * py;
+		const Float dirZ = cornerZ + dxZ * px + dyZ * py;
+		const Float invLength = Broadcast(1.0f) / Sqrt(dirX * dirX + dirY * dirY + dirZ * dirZ);
+		Store(outX + i, dirX * invLength);
+		Store(outY + i, dirY * invLength);
+		Store(outZ + i, dirZ * invLength);
+	}
 }
 
 void Camera::Move(float dt, DirectX::XMFLOAT3 v) noexcept
@@ -67,25 +94,38 @@ void Camera::Rotate(float dt, float deltaX, float deltaY) noexcept
 	m_rightDir = XMVector3Normalize(XMVector3Cross(m_forwardDir, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
 }
 
-void Camera::RecalculateRayDirections() noexcept
+void Camera::SetPose(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 forward) noexcept
 {
-	for (int y = 0; y < m_Height; ++y) {
-		for (int x = 0; x < m_Width; ++x) {
-			DirectX::XMFLOAT2 coord = { (float)x / (float)m_Width, (float)y / (float)m_Height };
-			coord.x = coord.x * 2.0f - 1.0f;
-			coord.y = coord.y * 2.0f - 1.0f;
+	m_Position = XMVectorSet(position.x, position.y, position.z, 1.0f);
+	m_forwardDir = XMVector3Normalize(XMLoadFloat3(&forward));
+	m_rightDir = XMVector3Normalize(XMVector3Cross(m_forwardDir, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+
+	RecalculateView();
+	RecalculateRayGenerator();
+	moved = false;
+}
 
-			XMVECTOR target = XMVector4Transform(XMVectorSet(coord.x, coord.y, 1.0f, 1.0f), m_InverseProjection); // homogeneous clip space
-			
-			target = XMVectorScale(target, 1.0f / XMVectorGetW(target)); // perspective divide
+void Camera::RecalculateRayGenerator() noexcept
+{
+	// Unprojecting a point on the far plane is affine in its NDC coordinates, and so
+	// is the world-space direction before normalization, so three vectors describe
+	// every primary ray.
+	auto unnormalizedDirection = [this](float x, float y) {
+		const float ndcX = x / (float)m_Width * 2.0f - 1.0f;
+		const float ndcY = y / (float)m_Height * 2.0f - 1.0f;
 
-			XMVECTOR rayVector = XMVector3Normalize(XMVector3TransformNormal(target, m_InverseView)); // world space
+		XMVECTOR target = XMVector4Transform(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), m_InverseProjection); // homogeneous clip space
 
-			XMFLOAT3 rayDirection;
-			XMStoreFloat3(&rayDirection, rayVector);
-			rayDirections[x + y * m_Width] = rayDirection;
-		}
-	}
+		target = XMVectorScale(target, 1.0f / XMVectorGetW(target)); // perspective divide
+
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, XMVector3TransformNormal(target, m_InverseView)); // world space
+		return direction;
+	};
+
+	rayGenerator.corner = unnormalizedDirection(0.0f, 0.0f);
+	rayGenerator.dx = Utils::Scale(Utils::Subtract(unnormalizedDirection((float)m_Width, 0.0f), rayGenerator.corner), 1.0f / (float)m_Width);
+	rayGenerator.dy = Utils::Scale(Utils::Subtract(unnormalizedDirection(0.0f, (float)m_Height), rayGenerator.corner), 1.0f / (float)m_Height);
 }
 
 bool Camera::Update() noexcept
@@ -93,8 +133,9 @@ bool Camera::Update() noexcept
 	bool temp = moved;
 
 	if (moved) {
+		PROFILE_ZONE("Camera rebuild");
 		RecalculateView();
-		RecalculateRayDirections();
+		RecalculateRayGenerator();
 		moved = false;
 	}
 
@@ -1,9 +1,22 @@
 #pragma once
 
 #include <DirectXMath.h>
-#include <vector>
+#include <cstdint>
 
 class Camera {
+public:
+	// Primary ray directions as an affine function of continuous pixel coordinates:
+	// pixel (x, y) looks along normalize(corner + x * dx + y * dy). Integer
+	// coordinates give the pixel corner; fractional ones give sub-pixel jitter.
+	struct RayGenerator {
+		DirectX::XMFLOAT3 corner;
+		DirectX::XMFLOAT3 dx;
+		DirectX::XMFLOAT3 dy;
+
+		DirectX::XMFLOAT3 GetDirection(float x, float y) const noexcept;
+		// count must be a multiple of Simd::width.
+		void GetDirections(const float* x, const float* y, uint32_t count, float* outX, float* outY, float* outZ) const noexcept;
+	};
 public:
 	Camera(int width, int height, float fovAngleYDegrees, float nearClip, float farClip);
 	const DirectX::XMMATRIX& GetProjection() const noexcept;
@@ -12,16 +25,17 @@ public:
 	const DirectX::XMMATRIX& GetInverseView() const noexcept;
 	const DirectX::XMVECTOR& GetPosition() const noexcept;
 	const DirectX::XMVECTOR& GetDirection() const noexcept;
-	const std::vector<DirectX::XMFLOAT3>& GetRayDirections() const noexcept;
+	const RayGenerator& GetRayGenerator() const noexcept;
 	void Move(float dt, DirectX::XMFLOAT3 v) noexcept;
 	void Rotate(float dt, float deltaX, float deltaY) noexcept;
+	void SetPose(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 forward) noexcept;
 	bool Update() noexcept;
 	void SetMoveSpeed(float speed) noexcept;
 	void SetRotationSpeed(float speed) noexcept;
 private:
 	void RecalculateProjection() noexcept;
 	void RecalculateView() noexcept;
-	void RecalculateRayDirections() noexcept;
+	void RecalculateRayGenerator() noexcept;
 private:
 	bool moved = false;
 	int m_Width = 0;
@@ -39,5 +53,5 @@ private:
 	DirectX::XMMATRIX m_InverseView;
 	DirectX::XMVECTOR m_forwardDir;
 	DirectX::XMVECTOR m_rightDir;
-	std::vector<DirectX::XMFLOAT3> rayDirections;
+	RayGenerator rayGenerator;
 };
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include "EnvironmentMap.h"
+#include "VectorUtils.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <math.h>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr char tableMagic[8] = { 'E', 'N', 'V', 'A', 'L', 'I', 'A', 'S' };
+	constexpr float oneMinusEpsilon = 0x1.fffffep-1f;
+
+	bool IsSpace(uint8_t c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	// Next whitespace-separated token of a PFM header; empty at the end of the data.
+	std::string ReadToken(const uint8_t* data, size_t size, size_t& offset)
+	{
+		while (offset < size && IsSpace(data[offset])) {
+			++offset;
+		}
+		const size_t start = offset;
+		while (offset < size && !IsSpace(data[offset])) {
+			++offset;
+		}
+		return std::string((const char*)data + start, offset - start);
+	}
+}
+
+EnvironmentMap::EnvironmentMap(const std::string& path, float scale)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_Map = std::make_unique<MappedFile>(path);
+	const uint8_t* data = m_Map->GetData();
+	const size_t size = m_Map->GetSize();
+
+	size_t offset = 0;
+	const std::string format = ReadToken(data, size, offset);
+	if (format != "PF" && format != "Pf") {
+		throw std::runtime_error(path + ": not a PFM image");
+	}
+	m_Channels = format == "PF" ? 3 : 1;
+	float fileScale = 0.0f;
+	try {
+		const int width = std::stoi(ReadToken(data, size, offset));
+		const int height = std::stoi(ReadToken(data, size, offset));
+		fileScale = std::stof(ReadToken(data, size, offset));
+		if (width <= 0 || height <= 0 || fileScale == 0.0f) {
+			throw std::invalid_argument("header");
+		}
+		m_Width = (uint32_t)width;
+		m_Height = (uint32_t)height;
+	}
+	catch (const std::logic_error&) {
+		throw std::runtime_error(path + ": malformed PFM header");
+	}
+	// A single whitespace character separates the header from the pixels.
+	++offset;
+	if (offset > size || size - offset < (size_t)m_Width * m_Height * m_Channels * sizeof(float)) {
+		throw std::runtime_error(path + ": PFM pixel data is truncated");
+	}
+	m_Pixels = data + offset;
+	// The sign of the scale gives the byte order, its magnitude a scale factor.
+	m_BigEndian = fileScale > 0.0f;
+	m_Scale = std::abs(fileScale) * scale;
+
+	TableHeader header = {};
+	std::memcpy(header.magic, tableMagic, sizeof(tableMagic));
+	header.version = tableVersion;
+	header.width = m_Width;
+	header.height = m_Height;
+	header.sourceSize = (uint64_t)size;
+	std::error_code error;
+	header.sourceTime = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+	const std::string tablePath = path + ".alias";
+	m_LoadStats.tablesCached = MapTables(tablePath, header);
+	if (!m_LoadStats.tablesCached) {
+		BuildTables(tablePath, header);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_LoadStats.loadTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+uint32_t EnvironmentMap::GetWidth() const noexcept
+{
+	return m_Width;
+}
+
+uint32_t EnvironmentMap::GetHeight() const noexcept
+{
+	return m_Height;
+}
+
+const EnvironmentMap::LoadStats& EnvironmentMap::GetLoadStats() const noexcept
+{
+	return m_LoadStats;
+}
+
+XMFLOAT3 EnvironmentMap::Lookup(const XMFLOAT3& direction) const
+{
+	uint32_t x, y;
+	TexelCoordinates(direction, x, y);
+	return Texel(x, y);
+}
+
+bool EnvironmentMap::Sample(const XMFLOAT2& u, XMFLOAT3& direction, float& pdf) const
+{
+	if (!(m_TotalWeight > 0.0)) {
+		return false;
+	}
+	float v, w;
+	const uint32_t y = PickAlias(m_Rows, m_Height, u.y, v);
+	const uint32_t x = PickAlias(m_Columns + (size_t)y * m_Width, m_Width, u.x, w);
+	const float weight = Weight(x, y);
+	const float theta = ((float)y + v) / (float)m_Height * XM_PI;
+	const float phi = ((float)x + w) / (float)m_Width * XM_2PI;
+	const float sinTheta = sinf(theta);
+	if (!(weight > 0.0f) || sinTheta <= 0.0f) {
+		return false;
+	}
+	direction = { sinTheta * cosf(phi), -cosf(theta), sinTheta * sinf(phi) };
+	// Texel probability times the texels per unit solid angle at this latitude.
+	pdf = (float)(weight / m_TotalWeight) * (float)m_Width * (float)m_Height / (2.0f * XM_PI * XM_PI * sinTheta);
+	return true;
+}
+
+float EnvironmentMap::Pdf(const XMFLOAT3& direction) const
+{
+	// From x and z rather than y, which loses the precision near the poles.
+	const float sinTheta = sqrtf(direction.x * direction.x + direction.z * direction.z);
+	if (!(m_TotalWeight > 0.0) || sinTheta <= 0.0f) {
+		return 0.0f;
+	}
+	uint32_t x, y;
+	TexelCoordinates(direction, x, y);
+	return (float)(Weight(x, y) / m_TotalWeight) * (float)m_Width * (float)m_Height / (2.0f * XM_PI * XM_PI * sinTheta);
+}
+
+XMFLOAT3 EnvironmentMap::Texel(uint32_t x, uint32_t y) const
+{
+	const size_t index = ((size_t)(m_Height - 1 - y) * m_Width + x) * m_Channels;
+	uint32_t bits[3];
+	std::memcpy(bits, m_Pixels + index * sizeof(float), m_Channels * sizeof(float));
+	float value[3] = {};
+	for (uint32_t c = 0; c < m_Channels; ++c) {
+		value[c] = std::bit_cast<float>(m_BigEndian ? std::byteswap(bits[c]) : bits[c]);
+	}
+	if (m_Channels == 1) {
+		value[1] = value[2] = value[0];
+	}
+	return { value[0] * m_Scale, value[1] * m_Scale, value[2] * m_Scale };
+}
+
+// Luminance times the solid angle of the texel's row, up to a constant.
+float EnvironmentMap::Weight(uint32_t x, uint32_t y) const
+{
+	const float sinTheta = sinf(((float)y + 0.5f) / (float)m_Height * XM_PI);
+	return std::max(Utils::Luminance(Texel(x, y)), 0.0f) * sinTheta;
+}
+
+bool EnvironmentMap::MapTables(const std::string& path, const TableHeader& expected)
+{
+	const size_t entries = (size_t)m_Height + (size_t)m_Width * m_Height;
+	try {
+		m_TableFile = std::make_unique<MappedFile>(path);
+	}
+	catch (const std::runtime_error&) {
+		return false;
+	}
+	TableHeader header;
+	if (m_TableFile->GetSize() != sizeof(TableHeader) + entries * sizeof(AliasEntry)) {
+		m_TableFile.reset();
+		return false;
+	}
+	std::memcpy(&header, m_TableFile->GetData(), sizeof(header));
+	if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version ||
+		header.width != expected.width || header.height != expected.height ||
+		header.sourceSize != expected.sourceSize || header.sourceTime != expected.sourceTime) {
+		m_TableFile.reset();
+		return false;
+	}
+	m_Rows = (const AliasEntry*)(m_TableFile->GetData() + sizeof(TableHeader));
+	m_Columns = m_Rows + m_Height;
+	m_TotalWeight = header.totalWeight;
+	return true;
+}
+
+void EnvironmentMap::BuildTables(const std::string& path, TableHeader header)
+{
+	std::vector<double> rowWeights(m_Height, 0.0);
+	for (uint32_t y = 0; y < m_Height; ++y) {
+		for (uint32_t x = 0; x < m_Width; ++x) {
+			rowWeights[y] += Weight(x, y);
+		}
+		header.totalWeight += rowWeights[y];
+	}
+
+	// Rows are built one at a time and streamed to the cache, so building takes
+	// memory for one row rather than for the whole table.
+	std::vector<AliasEntry> rows(m_Height);
+	BuildAlias(rowWeights.data(), m_Height, rows.data());
+	std::vector<double> columnWeights(m_Width);
+	std::vector<AliasEntry> columns(m_Width);
+	// Each writer streams to its own file and renames it whole, so processes loading
+	// the same map at once never interleave writes or rename one another's partial file.
+	std::random_device entropy;
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", entropy(), entropy());
+	const std::string temporaryPath = path + suffix;
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)rows.data(), rows.size() * sizeof(AliasEntry));
+		for (uint32_t y = 0; y < m_Height && file; ++y) {
+			for (uint32_t x = 0; x < m_Width; ++x) {
+				columnWeights[x] = Weight(x, y);
+			}
+			BuildAlias(columnWeights.data(), m_Width, columns.data());
+			file.write((const char*)columns.data(), columns.size() * sizeof(AliasEntry));
+		}
+		file.close();
+		std::error_code error;
+		bool cached = (bool)file;
+		if (cached) {
+			std::filesystem::rename(temporaryPath, path, error);
+			cached = !error && MapTables(path, header);
+		}
+		if (cached) {
+			return;
+		}
+		std::filesystem::remove(temporaryPath, error);
+	}
+
+	// No cache, e.g. next to a read-only map: keep the tables in memory.
+	m_OwnedTables.resize((size_t)m_Height + (size_t)m_Width * m_Height);
+	std::copy(rows.begin(), rows.end(), m_OwnedTables.begin());
+	for (uint32_t y = 0; y < m_Height; ++y) {
+		for (uint32_t x = 0; x < m_Width; ++x) {
+			columnWeights[x] = Weight(x, y);
+		}
+		BuildAlias(columnWeights.data(), m_Width, m_OwnedTables.data() + m_Height + (size_t)y * m_Width);
+	}
+	m_Rows = m_OwnedTables.data();
+	m_Columns = m_Rows + m_Height;
+	m_TotalWeight = header.totalWeight;
+}
+
+// Vose's alias method: every entry keeps its own share of 1/count and hands the
+// rest of its slot to one entry with more than its share.
+void EnvironmentMap::BuildAlias(const double* weights, uint32_t count, AliasEntry* table)
+{
+	double total = 0.0;
+	for (uint32_t i = 0; i < count; ++i) {
+		total += weights[i];
+	}
+	if (!(total > 0.0)) {
+		for (uint32_t i = 0; i < count; ++i) {
+			table[i] = { 1.0f, i };
+		}
+		return;
+	}
+
+	std::vector<double> scaled(count);
+	std::vector<uint32_t> small, large;
+	for (uint32_t i = 0; i < count; ++i) {
+		scaled[i] = weights[i] * count / total;
+		(scaled[i] < 1.0 ? small : large).push_back(i);
+	}
+	while (!small.empty() && !large.empty()) {
+		const uint32_t s = small.back();
+		const uint32_t l = large.back();
+		small.pop_back();
+		large.pop_back();
+		table[s] = { (float)scaled[s], l };
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		(scaled[l] < 1.0 ? small : large).push_back(l);
+	}
+	// Whatever is left holds its share up to rounding.
+	for (const uint32_t i : small) {
+		table[i] = { 1.0f, i };
+	}
+	for (const uint32_t i : large) {
+		table[i] = { 1.0f, i };
+	}
+}
+
+uint32_t EnvironmentMap::PickAlias(const AliasEntry* table, uint32_t count, float u, float& remainder)
+{
+	const float scaled = u * (float)count;
+	const uint32_t i = std::min((uint32_t)scaled, count - 1);
+	const float f = std::min(scaled - (float)i, oneMinusEpsilon);
+	const AliasEntry& entry = table[i];
+	// What is left of u after the choice is uniform again and picks the point in the texel.
+	if (f < entry.probability) {
+		remainder = std::min(f / entry.probability, oneMinusEpsilon);
+		return i;
+	}
+	remainder = std::min((f - entry.probability) / (1.0f - entry.probability), oneMinusEpsilon);
+	return entry.alias;
+}
+
+void EnvironmentMap::TexelCoordinates(const XMFLOAT3& direction, uint32_t& x, uint32_t& y) const
+{
+	const float theta = acosf(std::clamp(-direction.y, -1.0f, 1.0f));
+	float phi = atan2f(direction.z, direction.x);
+	if (phi < 0.0f) {
+		phi += XM_2PI;
+	}
+	x = std::min((uint32_t)(phi / XM_2PI * (float)m_Width), m_Width - 1);
+	y = std::min((uint32_t)(theta / XM_PI * (float)m_Height), m_Height - 1);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <DirectXMath.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Equirectangular HDR environment: the radiance of every direction that misses
+// the scene, importance-sampled in proportion to luminance over solid angle.
+// Maps are RGB or grayscale PFM files, read in place from a memory mapping.
+// Their alias tables are built on first load and cached next to the map as
+// <map>.alias, which later loads map the same way, so opening even a 16K map
+// touches only the pages rendering needs.
+class EnvironmentMap {
+public:
+	struct LoadStats {
+		float loadTime = 0.0f; // ms, including building the alias tables
+		bool tablesCached = false; // read from <map>.alias rather than built
+	};
+public:
+	// The top row of the image is straight up (-y); scale multiplies the radiance.
+	// Throws std::runtime_error naming the file on malformed input.
+	explicit EnvironmentMap(const std::string& path, float scale = 1.0f);
+	uint32_t GetWidth() const noexcept;
+	uint32_t GetHeight() const noexcept;
+	const LoadStats& GetLoadStats() const noexcept;
+	// Radiance arriving from a unit direction, from the nearest texel.
+	DirectX::XMFLOAT3 Lookup(const DirectX::XMFLOAT3& direction) const;
+	// Picks a direction from two uniform numbers in O(1): a row from the
+	// marginal alias table, a texel from that row's, and a point within it.
+	// False where the whole map is black.
+	bool Sample(const DirectX::XMFLOAT2& u, DirectX::XMFLOAT3& direction, float& pdf) const;
+	// Solid-angle density of Sample returning the direction.
+	float Pdf(const DirectX::XMFLOAT3& direction) const;
+private:
+	struct AliasEntry {
+		float probability; // of keeping this entry rather than its alias
+		uint32_t alias;
+	};
+	struct TableHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t reserved;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		double totalWeight;
+	};
+	DirectX::XMFLOAT3 Texel(uint32_t x, uint32_t y) const; // y from the top
+	float Weight(uint32_t x, uint32_t y) const;
+	bool MapTables(const std::string& path, const TableHeader& expected);
+	void BuildTables(const std::string& path, TableHeader header);
+	static void BuildAlias(const double* weights, uint32_t count, AliasEntry* table);
+	static uint32_t PickAlias(const AliasEntry* table, uint32_t count, float u, float& remainder);
+	void TexelCoordinates(const DirectX::XMFLOAT3& direction, uint32_t& x, uint32_t& y) const;
+private:
+	static constexpr uint32_t tableVersion = 1;
+	std::unique_ptr<MappedFile> m_Map;
+	std::unique_ptr<MappedFile> m_TableFile;
+	std::vector<AliasEntry> m_OwnedTables; // when the cache cannot be written
+	const uint8_t* m_Pixels = nullptr; // bottom row first, as PFM stores them
+	uint32_t m_Channels = 3;
+	bool m_BigEndian = false;
+	float m_Scale = 1.0f;
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	const AliasEntry* m_Rows = nullptr; // marginal over rows
+	const AliasEntry* m_Columns = nullptr; // conditional per row, width entries each
+	double m_TotalWeight = 0.0;
+	LoadStats m_LoadStats;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cassert>
+#include <memory>
+
+// CPU-side RGBA32F image the renderer writes into. Graphics uploads one to its
+// texture every frame; headless drivers read it back or save it.
+class Framebuffer {
+public:
+	Framebuffer(int width, int height)
+		:
+		m_Width(width),
+		m_Height(height),
+		m_Pixels(new DirectX::XMFLOAT4[width * height])
+	{
+	}
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer& operator=(const Framebuffer&) = delete;
+	inline void PutPixel(int x, int y, DirectX::XMFLOAT4 color)
+	{
+		assert(x >= 0 && x < m_Width);
+		assert(y >= 0 && y < m_Height);
+
+		m_Pixels[y * m_Width + x] = color;
+	}
+	inline DirectX::XMFLOAT4 GetPixel(int x, int y) const
+	{
+		assert(x >= 0 && x < m_Width);
+		assert(y >= 0 && y < m_Height);
+
+		return m_Pixels[y * m_Width + x];
+	}
+	inline void Clear(DirectX::XMFLOAT4 color) { std::fill_n(m_Pixels.get(), m_Width * m_Height, color); }
+	inline const DirectX::XMFLOAT4* GetData() const noexcept { return m_Pixels.get(); }
+	inline int GetWidth() const noexcept { return m_Width; }
+	inline int GetHeight() const noexcept { return m_Height; }
+private:
+	int m_Width;
+	int m_Height;
+	std::unique_ptr<DirectX::XMFLOAT4[]> m_Pixels;
+};
@@ -1,4 +1,5 @@
 #include "Graphics.h"
+#include "Profiler.h"
 
 #include <d3dcompiler.h>
 #include <stdexcept>
@@ -32,7 +33,7 @@ Graphics::Graphics(Window& wnd)
 	:
 	width(wnd.GetWidth()),
 	height(wnd.GetHeight()),
-	pixels(new XMFLOAT4[width * height])
+	framebuffer(width, height)
 {
 	viewPort = CD3DX12_VIEWPORT(0.0f, 0.0f, (FLOAT)width, (FLOAT)height);
 	rect = CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX);
@@ -404,7 +405,7 @@ void Graphics::StartUp(Window& wnd) {
 
 		pDevice->CreateShaderResourceView(pTexture.Get(), &desc, srvHeap->GetCPUDescriptorHandleForHeapStart());
 
-		textureData.pData = pixels.get();
+		textureData.pData = framebuffer.GetData();
 		textureData.RowPitch = width * sizeof(XMFLOAT4);
 		textureData.SlicePitch = textureData.RowPitch * height;
 	}
@@ -427,7 +428,9 @@ void Graphics::BeginFrame()
 	ImGui_ImplWin32_NewFrame();
 	ImGui_ImplDX12_NewFrame();
 	ImGui::NewFrame();
-	std::ranges::fill_n(pixels.get(), width * height, clearTextureColor);
+
+	PROFILE_ZONE("Clear framebuffer");
+	framebuffer.Clear(clearTextureColor);
 }
 
 void Graphics::EndFrame()
@@ -437,6 +440,7 @@ void Graphics::EndFrame()
 
 	// Update the texture
 	{
+		PROFILE_ZONE("Upload framebuffer");
 		{
 			auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(pTexture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
 			pCommandList->ResourceBarrier(1, &barrier);
@@ -494,6 +498,7 @@ void Graphics::EndFrame()
 	ID3D12CommandList* lists[] = {pCommandList.Get()};
 	pCommandQueue->ExecuteCommandLists(1, lists);
 
+	PROFILE_ZONE("Present");
 	pSwapChain->Present(1, 0);
 
 	ThrowIfFailed(pCommandQueue->Signal(pFence.Get(), ++fenceValue));
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Window.h"
+#include "Framebuffer.h"
 #include <wrl.h>
 #include <d3d12.h>
 #include <dxgi1_6.h>
@@ -17,20 +18,7 @@ public:
 	~Graphics();
 	void BeginFrame();
 	void EndFrame();
-	inline void PutPixel(int x, int y, DirectX::XMFLOAT4 color)
-	{
-		assert(x >= 0 && x <= width);
-		assert(y >= 0 && y <= height);
-
-		pixels[y * width + x] = color;
-	}
-	inline DirectX::XMFLOAT4 GetPixel(int x, int y) const
-	{
-		assert(x >= 0 && x <= width);
-		assert(y >= 0 && y <= height);
-
-		return  pixels[y * width + x];
-	}
+	inline Framebuffer& GetFramebuffer() noexcept { return framebuffer; }
 	inline int GetWidth() const noexcept { return width; }
 	inline int GetHeight() const noexcept { return height; }
 	inline void SetTextureClearColor(DirectX::XMFLOAT4 color) { clearTextureColor = color; }
@@ -74,5 +62,5 @@ private:
 	D3D12_SUBRESOURCE_DATA textureData;
 	D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
 	D3D12_INDEX_BUFFER_VIEW indexBufferView;
-	std::unique_ptr<DirectX::XMFLOAT4[]> pixels = nullptr;
+	Framebuffer framebuffer;
 };
\ No newline at end of file
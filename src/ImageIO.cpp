@@ -0,0 +1,138 @@
+#include "ImageIO.h"
+#include "VectorUtils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		static const auto table = [] {
+			std::vector<uint32_t> t(256);
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				t[n] = c;
+			}
+			return t;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t Adler32(const uint8_t* data, size_t size)
+	{
+		uint32_t a = 1, b = 0;
+		for (size_t i = 0; i < size; ++i) {
+			a = (a + data[i]) % 65521u;
+			b = (b + a) % 65521u;
+		}
+		return (b << 16) | a;
+	}
+
+	void PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back((uint8_t)(value >> 24));
+		out.push_back((uint8_t)(value >> 16));
+		out.push_back((uint8_t)(value >> 8));
+		out.push_back((uint8_t)value);
+	}
+
+	void PutChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data)
+	{
+		PutBigEndian(png, (uint32_t)data.size());
+		const size_t typeOffset = png.size();
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+		PutBigEndian(png, Crc32(png.data() + typeOffset, png.size() - typeOffset));
+	}
+
+	bool WriteFile(const char* path, const void* data, size_t size)
+	{
+		FILE* file = std::fopen(path, "wb");
+		if (!file) {
+			return false;
+		}
+		const bool written = std::fwrite(data, 1, size, file) == size;
+		return std::fclose(file) == 0 && written;
+	}
+}
+
+bool ImageIO::WritePFM(const char* path, const Framebuffer& framebuffer)
+{
+	const int width = framebuffer.GetWidth();
+	const int height = framebuffer.GetHeight();
+
+	// A negative scale marks little-endian data. PFM stores the bottom row first.
+	char header[64];
+	const int headerSize = std::snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", width, height);
+	std::vector<uint8_t> file(header, header + headerSize);
+	std::vector<float> row((size_t)width * 3);
+	for (int y = height - 1; y >= 0; --y) {
+		for (int x = 0; x < width; ++x) {
+			const DirectX::XMFLOAT4 color = framebuffer.GetPixel(x, y);
+			row[x * 3 + 0] = color.x;
+			row[x * 3 + 1] = color.y;
+			row[x * 3 + 2] = color.z;
+		}
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row.data());
+		file.insert(file.end(), bytes, bytes + row.size() * sizeof(float));
+	}
+	return WriteFile(path, file.data(), file.size());
+}
+
+bool ImageIO::WritePNG(const char* path, const Framebuffer& framebuffer)
+{
+	const int width = framebuffer.GetWidth();
+	const int height = framebuffer.GetHeight();
+
+	// Scanlines with filter type 0 (none).
+	std::vector<uint8_t> raw;
+	raw.reserve((size_t)height * (1 + (size_t)width * 3));
+	for (int y = 0; y < height; ++y) {
+		raw.push_back(0);
+		for (int x = 0; x < width; ++x) {
+			const DirectX::XMFLOAT4 color = Utils::DisplayTransform(framebuffer.GetPixel(x, y));
+			raw.push_back((uint8_t)(color.x * 255.0f + 0.5f));
+			raw.push_back((uint8_t)(color.y * 255.0f + 0.5f));
+			raw.push_back((uint8_t)(color.z * 255.0f + 0.5f));
+		}
+	}
+
+	// zlib stream of stored (uncompressed) deflate blocks: bigger files, no dependency.
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	constexpr size_t maxBlock = 65535;
+	for (size_t offset = 0; offset < raw.size() || offset == 0; offset += maxBlock) {
+		const size_t size = std::min(maxBlock, raw.size() - offset);
+		const bool last = offset + size >= raw.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back((uint8_t)size);
+		zlib.push_back((uint8_t)(size >> 8));
+		zlib.push_back((uint8_t)~size);
+		zlib.push_back((uint8_t)(~size >> 8));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+		if (last) {
+			break;
+		}
+	}
+	PutBigEndian(zlib, Adler32(raw.data(), raw.size()));
+
+	std::vector<uint8_t> header;
+	PutBigEndian(header, (uint32_t)width);
+	PutBigEndian(header, (uint32_t)height);
+	header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, deflate, adaptive filtering, no interlace
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	PutChunk(png, "IHDR", header);
+	PutChunk(png, "IDAT", zlib);
+	PutChunk(png, "IEND", {});
+	return WriteFile(path, png.data(), png.size());
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Framebuffer.h"
+
+// Image writers without third-party dependencies. Both return false if the file
+// cannot be written.
+namespace ImageIO
+{
+	// Little-endian RGB float PFM: linear radiance, unclamped.
+	bool WritePFM(const char* path, const Framebuffer& framebuffer);
+	// 8-bit RGB PNG of linear radiance through the app's display transform
+	// (Utils::DisplayTransform: ACES filmic tonemap, then sRGB encoding).
+	bool WritePNG(const char* path, const Framebuffer& framebuffer);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Ray.h"
+#include "Scene.h"
+#include <DirectXMath.h>
+#include <math.h>
+#include <algorithm>
+
+namespace Utils
+{
+	// Returns distance to the near intersection or -1 when the sphere is missed
+	// or lies behind the ray origin. Matches the semantics TraceRay always had.
+	inline float IntersectSphere(const Ray& ray, const Sphere& sphere) {
+		DirectX::XMFLOAT3 origin = {
+			ray.origin.x - sphere.position.x,
+			ray.origin.y - sphere.position.y,
+			ray.origin.z - sphere.position.z
+		};
+
+		// Half-b form of the quadratic; identical to the SIMD kernels in SphereSoA.
+		float a = ray.direction.x * ray.direction.x + ray.direction.y * ray.direction.y + ray.direction.z * ray.direction.z;
+		float halfB = origin.x * ray.direction.x + origin.y * ray.direction.y + origin.z * ray.direction.z;
+		float c = origin.x * origin.x + origin.y * origin.y + origin.z * origin.z - sphere.radius * sphere.radius;
+
+		float D = halfB * halfB - a * c;
+		if (D < 0.0f) {
+			return -1.0f;
+		}
+
+		const float closestHit = (-halfB - sqrtf(D)) / a;
+		return closestHit >= 0.0f ? closestHit : -1.0f;
+	}
+
+	// Slab test. Returns entry distance, or +inf when the box is missed
+	// or lies entirely outside [0, tMax).
+	inline float IntersectAABB(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& invDirection,
+		const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, float tMax) {
+		float tx1 = (boxMin.x - origin.x) * invDirection.x;
+		float tx2 = (boxMax.x - origin.x) * invDirection.x;
+		float tNear = std::min(tx1, tx2);
+		float tFar = std::max(tx1, tx2);
+
+		float ty1 = (boxMin.y - origin.y) * invDirection.y;
+		float ty2 = (boxMax.y - origin.y) * invDirection.y;
+		tNear = std::max(tNear, std::min(ty1, ty2));
+		tFar = std::min(tFar, std::max(ty1, ty2));
+
+		float tz1 = (boxMin.z - origin.z) * invDirection.z;
+		float tz2 = (boxMax.z - origin.z) * invDirection.z;
+		tNear = std::max(tNear, std::min(tz1, tz2));
+		tFar = std::min(tFar, std::max(tz1, tz2));
+
+		if (tFar >= tNear && tFar >= 0.0f && tNear < tMax) {
+			return tNear;
+		}
+		return INFINITY;
+	}
+}
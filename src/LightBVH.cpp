@@ -0,0 +1,295 @@
+#include "LightBVH.h"
+#include "Bounds.h"
+#include "VectorUtils.h"
+
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+#include <math.h>
+
+using namespace DirectX;
+
+namespace
+{
+	struct BuildLight {
+		Bounds bounds;
+		XMFLOAT3 centroid;
+		float radius;
+		float power;
+	};
+
+	inline float Component(const XMFLOAT3& v, int axis) {
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+}
+
+void LightBVH::Build(const Scene& scene)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Clear();
+
+	for (uint32_t i = 0; i < (uint32_t)scene.spheres.size(); ++i) {
+		if (scene.materials[scene.spheres[i].materialIndex].IsEmissive()) {
+			m_Lights.push_back(i);
+		}
+	}
+	const uint32_t nLights = (uint32_t)m_Lights.size();
+	if (nLights == 0) {
+		return;
+	}
+
+	// Power is the emitted flux up to a constant: radiance times surface area.
+	std::vector<BuildLight> lights(nLights);
+	for (uint32_t slot = 0; slot < nLights; ++slot) {
+		const Sphere& sphere = scene.spheres[m_Lights[slot]];
+		const float r = std::abs(sphere.radius);
+		BuildLight& light = lights[slot];
+		light.bounds = { { sphere.position.x - r, sphere.position.y - r, sphere.position.z - r },
+			{ sphere.position.x + r, sphere.position.y + r, sphere.position.z + r } };
+		light.centroid = sphere.position;
+		light.radius = r;
+		light.power = Utils::Luminance(scene.materials[sphere.materialIndex].Emission) * r * r;
+	}
+
+	std::vector<uint32_t> order(nLights);
+	std::iota(order.begin(), order.end(), 0u);
+
+	struct StackEntry {
+		uint32_t node;
+		uint32_t first;
+		uint32_t count;
+		uint32_t depth;
+	};
+	m_Nodes.reserve(2 * (size_t)nLights - 1);
+	m_Nodes.push_back({});
+	m_Nodes[0].parent = UINT32_MAX;
+	std::vector<StackEntry> stack = { { 0u, 0u, nLights, 1u } };
+
+	while (!stack.empty()) {
+		const auto [nodeIndex, first, count, depth] = stack.back();
+		stack.pop_back();
+
+		m_BuildStats.maxDepth = std::max(m_BuildStats.maxDepth, depth);
+
+		Bounds bounds, centroidBounds;
+		float power = 0.0f;
+		for (uint32_t i = first; i < first + count; ++i) {
+			bounds.Grow(lights[order[i]].bounds);
+			centroidBounds.Grow(lights[order[i]].centroid);
+			power += lights[order[i]].power;
+		}
+
+		Node& node = m_Nodes[nodeIndex];
+		node.power = power;
+		if (count == 1) {
+			node.center = lights[order[first]].centroid;
+			node.radius = lights[order[first]].radius;
+			node.child = order[first];
+			node.leaf = true;
+			continue;
+		}
+		node.center = Utils::Scale(Utils::Add(bounds.min, bounds.max), 0.5f);
+		node.radius = 0.0f;
+		for (uint32_t i = first; i < first + count; ++i) {
+			const BuildLight& light = lights[order[i]];
+			node.radius = std::max(node.radius, Utils::Magnitude(Utils::Subtract(light.centroid, node.center)) + light.radius);
+		}
+		node.leaf = false;
+
+		// Binned split minimizing power times area on each side: the chance a
+		// child is picked grows with its power, the cost of a poor pick with its size.
+		int bestAxis = -1;
+		int bestBin = 0;
+		float bestCost = INFINITY;
+		const XMFLOAT3 extent = Utils::Subtract(centroidBounds.max, centroidBounds.min);
+		for (int axis = 0; axis < 3 && depth < medianSplitDepth; ++axis) {
+			const float axisMin = Component(centroidBounds.min, axis);
+			const float axisExtent = Component(extent, axis);
+			if (axisExtent <= 0.0f) {
+				continue;
+			}
+			Bounds binBounds[nBins];
+			float binPower[nBins] = {};
+			for (uint32_t i = first; i < first + count; ++i) {
+				const BuildLight& light = lights[order[i]];
+				const int bin = std::min((int)((Component(light.centroid, axis) - axisMin) / axisExtent * nBins), nBins - 1);
+				binBounds[bin].Grow(light.bounds);
+				binPower[bin] += light.power;
+			}
+			float rightCost[nBins] = {};
+			Bounds right;
+			float rightPower = 0.0f;
+			for (int bin = nBins - 1; bin > 0; --bin) {
+				right.Grow(binBounds[bin]);
+				rightPower += binPower[bin];
+				rightCost[bin] = right.Empty() ? INFINITY : rightPower * right.Area();
+			}
+			Bounds left;
+			float leftPower = 0.0f;
+			for (int bin = 0; bin < nBins - 1; ++bin) {
+				left.Grow(binBounds[bin]);
+				leftPower += binPower[bin];
+				const float cost = leftPower * left.Area() + rightCost[bin + 1];
+				if (!left.Empty() && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		auto begin = order.begin() + first;
+		auto end = begin + count;
+		auto middle = begin;
+		if (bestAxis >= 0) {
+			const float axisMin = Component(centroidBounds.min, bestAxis);
+			const float axisExtent = Component(extent, bestAxis);
+			middle = std::partition(begin, end, [&](uint32_t slot) {
+				return std::min((int)((Component(lights[slot].centroid, bestAxis) - axisMin) / axisExtent * nBins), nBins - 1) <= bestBin;
+			});
+		}
+		if (middle == begin || middle == end) {
+			// Coincident centroids or a tree too deep: median split on the widest axis.
+			const int axis = extent.x > extent.y && extent.x > extent.z ? 0 : (extent.y > extent.z ? 1 : 2);
+			middle = begin + count / 2;
+			std::nth_element(begin, middle, end, [&](uint32_t l, uint32_t r) {
+				return Component(lights[l].centroid, axis) < Component(lights[r].centroid, axis);
+			});
+		}
+
+		const uint32_t leftCount = (uint32_t)(middle - begin);
+		const uint32_t leftIndex = (uint32_t)m_Nodes.size();
+		m_Nodes[nodeIndex].child = leftIndex;
+		m_Nodes.push_back({});
+		m_Nodes.push_back({});
+		m_Nodes[leftIndex].parent = nodeIndex;
+		m_Nodes[leftIndex + 1].parent = nodeIndex;
+		stack.push_back({ leftIndex, first, leftCount, depth + 1 });
+		stack.push_back({ leftIndex + 1, first + leftCount, count - leftCount, depth + 1 });
+	}
+
+	m_Leaves.resize(nLights);
+	for (uint32_t nodeIndex = 0; nodeIndex < (uint32_t)m_Nodes.size(); ++nodeIndex) {
+		if (m_Nodes[nodeIndex].leaf) {
+			m_Leaves[m_Nodes[nodeIndex].child] = nodeIndex;
+		}
+	}
+	m_BuildStats.nodeCount = (uint32_t)m_Nodes.size();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_BuildStats.buildTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void LightBVH::Clear() noexcept
+{
+	m_Nodes.clear();
+	m_Lights.clear();
+	m_Leaves.clear();
+	m_BuildStats = {};
+}
+
+bool LightBVH::Empty() const noexcept
+{
+	return m_Lights.empty();
+}
+
+const std::vector<uint32_t>& LightBVH::GetLights() const noexcept
+{
+	return m_Lights;
+}
+
+bool LightBVH::IsLight(uint32_t sphereIndex) const
+{
+	return std::binary_search(m_Lights.begin(), m_Lights.end(), sphereIndex);
+}
+
+uint32_t LightBVH::Sample(const XMFLOAT3& position, const XMFLOAT3& normal, float u, float& probability) const
+{
+	probability = 0.0f;
+	if (m_Nodes.empty()) {
+		return UINT32_MAX;
+	}
+
+	// Each level reuses what is left of u after the choice, rescaled to [0, 1).
+	constexpr float oneMinusEpsilon = 0x1.fffffep-1f;
+	float p = 1.0f;
+	uint32_t nodeIndex = 0;
+	while (!m_Nodes[nodeIndex].leaf) {
+		const Node& node = m_Nodes[nodeIndex];
+		const float left = Importance(m_Nodes[node.child], position, normal);
+		const float right = Importance(m_Nodes[node.child + 1], position, normal);
+		if (!(left + right > 0.0f)) {
+			return UINT32_MAX;
+		}
+		const float pLeft = left / (left + right);
+		if (u < pLeft) {
+			u = std::min(u / pLeft, oneMinusEpsilon);
+			p *= pLeft;
+			nodeIndex = node.child;
+		}
+		else {
+			u = std::min((u - pLeft) / (1.0f - pLeft), oneMinusEpsilon);
+			p *= 1.0f - pLeft;
+			nodeIndex = node.child + 1;
+		}
+	}
+	probability = p;
+	return m_Lights[m_Nodes[nodeIndex].child];
+}
+
+float LightBVH::Probability(const XMFLOAT3& position, const XMFLOAT3& normal, uint32_t sphereIndex) const
+{
+	const auto it = std::lower_bound(m_Lights.begin(), m_Lights.end(), sphereIndex);
+	if (it == m_Lights.end() || *it != sphereIndex) {
+		return 0.0f;
+	}
+
+	// The same choices Sample makes, from the leaf up.
+	float p = 1.0f;
+	uint32_t nodeIndex = m_Leaves[it - m_Lights.begin()];
+	while (m_Nodes[nodeIndex].parent != UINT32_MAX) {
+		const Node& parent = m_Nodes[m_Nodes[nodeIndex].parent];
+		const float left = Importance(m_Nodes[parent.child], position, normal);
+		const float right = Importance(m_Nodes[parent.child + 1], position, normal);
+		if (!(left + right > 0.0f)) {
+			return 0.0f;
+		}
+		const float pLeft = left / (left + right);
+		p *= nodeIndex == parent.child ? pLeft : 1.0f - pLeft;
+		nodeIndex = m_Nodes[nodeIndex].parent;
+	}
+	return p;
+}
+
+const LightBVH::BuildStats& LightBVH::GetBuildStats() const noexcept
+{
+	return m_BuildStats;
+}
+
+float LightBVH::Importance(const Node& node, const XMFLOAT3& position, const XMFLOAT3& normal)
+{
+	const XMFLOAT3 toCenter = Utils::Subtract(node.center, position);
+	const float distanceSq = Utils::Dot(toCenter, toCenter);
+	const float radiusSq = node.radius * node.radius;
+	// Inside the bounds any direction may reach a light and distance says little.
+	if (distanceSq <= radiusSq) {
+		return radiusSq > 0.0f ? node.power / radiusSq : 0.0f;
+	}
+
+	// Smallest angle between the normal and any direction into the bounding
+	// sphere: the normal's angle to its center less the sphere's half-angle.
+	const float distance = sqrtf(distanceSq);
+	const float cosTheta = Utils::Dot(toCenter, normal) / distance;
+	const float sinBoundSq = radiusSq / distanceSq;
+	const float cosBound = sqrtf(1.0f - sinBoundSq);
+	float cosClosest = 1.0f;
+	if (cosTheta < cosBound) {
+		const float sinTheta = sqrtf(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+		cosClosest = cosTheta * cosBound + sinTheta * sqrtf(sinBoundSq);
+	}
+	if (cosClosest <= 0.0f) {
+		return 0.0f;
+	}
+	return node.power * cosClosest / distanceSq;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Scene.h"
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+// Hierarchy over the emissive spheres of a scene, for picking one light per
+// shading point in proportion to an estimate of what it contributes there
+// (Conty Estevez and Kulla, "Importance Sampling of Many Lights with Adaptive
+// Tree Splitting", 2018). Nodes hold a bounding sphere and the summed power of
+// their lights. Spheres emit in every direction, so nodes need no emission
+// cone; the bound on the cosine at the receiver is what rules lights out.
+class LightBVH {
+public:
+	struct BuildStats {
+		float buildTime = 0.0f; // ms
+		uint32_t nodeCount = 0;
+		uint32_t maxDepth = 0;
+	};
+public:
+	void Build(const Scene& scene);
+	void Clear() noexcept;
+	bool Empty() const noexcept;
+	// Scene::spheres indices of the emissive spheres, ascending.
+	const std::vector<uint32_t>& GetLights() const noexcept;
+	bool IsLight(uint32_t sphereIndex) const;
+	// Picks a light for a point with the given normal by descending the tree, u
+	// in [0, 1) choosing at every level. Returns the Scene::spheres index and its
+	// probability, or UINT32_MAX where no light can reach the point.
+	uint32_t Sample(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& normal, float u, float& probability) const;
+	// Probability that Sample picks the sphere from the same point; O(depth).
+	float Probability(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& normal, uint32_t sphereIndex) const;
+	const BuildStats& GetBuildStats() const noexcept;
+private:
+	struct Node {
+		DirectX::XMFLOAT3 center; // of a sphere bounding every light below
+		float radius;
+		float power; // summed over the lights below
+		uint32_t child; // first of two children for inner nodes, slot in m_Lights for leaves
+		uint32_t parent; // UINT32_MAX at the root
+		bool leaf;
+	};
+	// Estimate of the light the node sends to the point, up to a common factor.
+	static float Importance(const Node& node, const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& normal);
+private:
+	static constexpr int nBins = 12;
+	static constexpr uint32_t medianSplitDepth = 40; // below this the power split gives way to median splits to bound depth
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_Lights;
+	std::vector<uint32_t> m_Leaves; // per slot in m_Lights, its leaf
+	BuildStats m_BuildStats;
+};
@@ -0,0 +1,101 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+{
+	m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE) {
+		m_File = nullptr;
+		throw std::runtime_error("Failed to open " + path);
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_File, &size)) {
+		CloseHandle(m_File);
+		throw std::runtime_error("Failed to read the size of " + path);
+	}
+	m_Size = (size_t)size.QuadPart;
+	if (m_Size == 0) {
+		return;
+	}
+	m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	m_Data = m_Mapping ? (const uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!m_Data) {
+		if (m_Mapping) {
+			CloseHandle(m_Mapping);
+		}
+		CloseHandle(m_File);
+		throw std::runtime_error("Failed to map " + path);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_Data) {
+		UnmapViewOfFile(m_Data);
+	}
+	if (m_Mapping) {
+		CloseHandle(m_Mapping);
+	}
+	if (m_File) {
+		CloseHandle(m_File);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		throw std::runtime_error("Failed to open " + path);
+	}
+	struct stat status;
+	if (fstat(file, &status) != 0) {
+		close(file);
+		throw std::runtime_error("Failed to read the size of " + path);
+	}
+	m_Size = (size_t)status.st_size;
+	if (m_Size > 0) {
+		void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED) {
+			close(file);
+			throw std::runtime_error("Failed to map " + path);
+		}
+		m_Data = (const uint8_t*)data;
+	}
+	// The mapping keeps the file alive on its own.
+	close(file);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_Data) {
+		munmap((void*)m_Data, m_Size);
+	}
+}
+
+#endif
+
+const uint8_t* MappedFile::GetData() const noexcept
+{
+	return m_Data;
+}
+
+size_t MappedFile::GetSize() const noexcept
+{
+	return m_Size;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of a whole file mapped into memory. Pages are read on first
+// touch, so opening a large file costs about as much as opening a small one.
+class MappedFile {
+public:
+	// Throws std::runtime_error naming the file if it cannot be opened or mapped.
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	const uint8_t* GetData() const noexcept;
+	size_t GetSize() const noexcept;
+private:
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+#ifdef _WIN32
+	void* m_File = nullptr; // HANDLE
+	void* m_Mapping = nullptr; // HANDLE
+#endif
+};
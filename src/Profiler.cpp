@@ -0,0 +1,144 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Event {
+		const char* name;
+		int64_t begin;
+		int64_t end;
+		Profiler::Region region;
+	};
+
+	struct ThreadBuffer {
+		static constexpr uint64_t capacity = 1u << 15; // events kept per thread
+		std::string name;
+		uint32_t id = 0;
+		uint64_t count = 0; // events ever written; the latest capacity of them are kept
+		std::unique_ptr<Event[]> events{ new Event[capacity] };
+	};
+
+	// Buffers are registered once per thread and live until exit, so a trace still
+	// shows threads that have finished, e.g. workers of a resized pool.
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+	thread_local ThreadBuffer* threadBuffer = nullptr;
+	thread_local std::string threadName;
+
+	const auto epoch = std::chrono::steady_clock::now();
+
+	ThreadBuffer& GetThreadBuffer()
+	{
+		if (!threadBuffer) {
+			std::lock_guard<std::mutex> lock(registryMutex);
+			auto& buffer = registry.emplace_back(std::make_unique<ThreadBuffer>());
+			buffer->id = (uint32_t)registry.size();
+			buffer->name = threadName.empty() ? "Thread " + std::to_string(buffer->id) : threadName;
+			threadBuffer = buffer.get();
+		}
+		return *threadBuffer;
+	}
+
+	void AppendJsonString(std::string& out, const std::string& s)
+	{
+		out += '"';
+		for (char c : s) {
+			if (c == '"' || c == '\\') {
+				out += '\\';
+			}
+			out += (unsigned char)c < 0x20 ? ' ' : c;
+		}
+		out += '"';
+	}
+}
+
+std::atomic<bool> Profiler::Detail::recording = false;
+
+int64_t Profiler::Detail::Now() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::Detail::Record(const char* name, int64_t begin, int64_t end, const Region& region)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+	buffer.events[buffer.count % ThreadBuffer::capacity] = { name, begin, end, region };
+	++buffer.count;
+}
+
+void Profiler::SetRecording(bool recording) noexcept
+{
+	Detail::recording.store(recording, std::memory_order_relaxed);
+}
+
+bool Profiler::IsRecording() noexcept
+{
+	return Detail::recording.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	threadName = name;
+	if (threadBuffer) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		threadBuffer->name = threadName;
+	}
+}
+
+void Profiler::Clear()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (auto& buffer : registry) {
+		buffer->count = 0;
+	}
+}
+
+bool Profiler::WriteChromeTrace(const char* path)
+{
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	char line[256];
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (const auto& buffer : registry) {
+			json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(buffer->id) + ",\"args\":{\"name\":";
+			AppendJsonString(json, buffer->name);
+			json += "}},\n";
+
+			const uint64_t first = buffer->count > ThreadBuffer::capacity ? buffer->count - ThreadBuffer::capacity : 0;
+			for (uint64_t i = first; i < buffer->count; ++i) {
+				const Event& event = buffer->events[i % ThreadBuffer::capacity];
+				json += "{\"name\":";
+				AppendJsonString(json, event.name);
+				// Complete events in microseconds, the trace format's unit.
+				std::snprintf(line, sizeof(line), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+					buffer->id, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+				json += line;
+				if (event.region.width > 0) {
+					std::snprintf(line, sizeof(line), ",\"args\":{\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d}",
+						event.region.x, event.region.y, event.region.width, event.region.height);
+					json += line;
+				}
+				json += "},\n";
+			}
+		}
+	}
+	// The format tolerates a trailing comma, but strict JSON readers do not.
+	if (json.ends_with(",\n")) {
+		json.erase(json.size() - 2, 1);
+	}
+	json += "]}\n";
+
+	FILE* file = std::fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	const bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+	return std::fclose(file) == 0 && written;
+}
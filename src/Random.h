@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+// Stateless counter-based random numbers. Every value is a pure function of
+// (pixel, frame, bounce, dimension), so images do not depend on which thread
+// rendered a pixel and no generator state has to live per thread.
+namespace Random
+{
+	struct Key {
+		uint32_t pixel;
+		uint32_t frame;
+		uint32_t bounce;
+		uint32_t dimension;
+	};
+
+	// pcg4d from Jarzynski & Olano, "Hash Functions for GPU Rendering" (JCGT 2020).
+	inline Key Hash(Key v) {
+		v.pixel = v.pixel * 1664525u + 1013904223u;
+		v.frame = v.frame * 1664525u + 1013904223u;
+		v.bounce = v.bounce * 1664525u + 1013904223u;
+		v.dimension = v.dimension * 1664525u + 1013904223u;
+
+		v.pixel += v.frame * v.dimension;
+		v.frame += v.bounce * v.pixel;
+		v.bounce += v.pixel * v.frame;
+		v.dimension += v.frame * v.bounce;
+
+		v.pixel ^= v.pixel >> 16u;
+		v.frame ^= v.frame >> 16u;
+		v.bounce ^= v.bounce >> 16u;
+		v.dimension ^= v.dimension >> 16u;
+
+		v.pixel += v.frame * v.dimension;
+		v.frame += v.bounce * v.pixel;
+		v.bounce += v.pixel * v.frame;
+		v.dimension += v.frame * v.bounce;
+
+		return v;
+	}
+
+	// Top 24 bits to a float in [0, 1).
+	inline float ToFloat(uint32_t bits) {
+		return (float)(bits >> 8) * (1.0f / 16777216.0f);
+	}
+
+	inline uint32_t UInt(uint32_t pixel, uint32_t frame, uint32_t bounce, uint32_t dimension) {
+		return Hash({ pixel, frame, bounce, dimension }).pixel;
+	}
+
+	inline float Float(uint32_t pixel, uint32_t frame, uint32_t bounce, uint32_t dimension) {
+		return ToFloat(UInt(pixel, frame, bounce, dimension));
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Simd.h"
+#include <DirectXMath.h>
+#include <cstdint>
+
+// A square tile of primary rays that share the camera origin, stored per
+// component so SIMD lanes run across rays.
+// Lanes past count are padding: they are traced but their results are ignored.
+struct RayPacket {
+	static constexpr uint32_t tileSize = 8;
+	static constexpr uint32_t maxSize = tileSize * tileSize;
+	static constexpr uint32_t maxGroups = maxSize / Simd::width;
+
+	DirectX::XMFLOAT3 origin;
+	uint32_t count = 0;
+	alignas(32) float directionX[maxSize];
+	alignas(32) float directionY[maxSize];
+	alignas(32) float directionZ[maxSize];
+	alignas(32) float hitDistance[maxSize];
+	alignas(32) int32_t objectIndex[maxSize];
+
+	// One bit per SIMD lane group that holds at least one real ray.
+	uint64_t GroupMask() const {
+		const uint32_t groups = (count + Simd::width - 1) / Simd::width;
+		return groups >= 64 ? ~0ull : (1ull << groups) - 1ull;
+	}
+};
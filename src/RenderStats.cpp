@@ -0,0 +1,52 @@
+#include "RenderStats.h"
+
+#include <cstdio>
+
+void RenderCounters::Merge(const RenderCounters& other) noexcept
+{
+	primaryRays += other.primaryRays;
+	secondaryRays += other.secondaryRays;
+	shadowRays += other.shadowRays;
+	misses += other.misses;
+	nodesVisited += other.nodesVisited;
+	sphereTests += other.sphereTests;
+	for (uint32_t i = 0; i <= maxPathLength; ++i) {
+		pathLengths[i] += other.pathLengths[i];
+	}
+	surfaceHits += other.surfaceHits;
+	rouletteTerminations += other.rouletteTerminations;
+}
+
+double RenderCounters::MeanPathLength() const noexcept
+{
+	uint64_t paths = 0;
+	for (uint64_t count : pathLengths) {
+		paths += count;
+	}
+	return paths > 0 ? (double)surfaceHits / (double)paths : 0.0;
+}
+
+std::string RenderStats::ToJson() const
+{
+	char buffer[512];
+	std::snprintf(buffer, sizeof(buffer),
+		"{ \"frame\": %llu, \"frameTime\": %.4f, \"countersEnabled\": %s, \"primaryRays\": %llu, \"secondaryRays\": %llu, \"shadowRays\": %llu, "
+		"\"misses\": %llu, \"nodesVisited\": %llu, \"sphereTests\": %llu, \"pathLengths\": [",
+		(unsigned long long)frameIndex, frameTime, countersEnabled ? "true" : "false",
+		(unsigned long long)counters.primaryRays, (unsigned long long)counters.secondaryRays, (unsigned long long)counters.shadowRays, (unsigned long long)counters.misses,
+		(unsigned long long)counters.nodesVisited, (unsigned long long)counters.sphereTests);
+	std::string json = buffer;
+	for (uint32_t i = 0; i <= RenderCounters::maxPathLength; ++i) {
+		std::snprintf(buffer, sizeof(buffer), "%s%llu", i == 0 ? "" : ", ", (unsigned long long)counters.pathLengths[i]);
+		json += buffer;
+	}
+	std::snprintf(buffer, sizeof(buffer), "], \"meanPathLength\": %.4f, \"rouletteTerminations\": %llu, \"workers\": [",
+		counters.MeanPathLength(), (unsigned long long)counters.rouletteTerminations);
+	json += buffer;
+	for (size_t i = 0; i < workers.size(); ++i) {
+		std::snprintf(buffer, sizeof(buffer), "%s{ \"busyTime\": %.4f, \"idleTime\": %.4f, \"tiles\": %u }",
+			i == 0 ? "" : ", ", workers[i].busyTime, workers[i].idleTime, workers[i].tiles);
+		json += buffer;
+	}
+	return json + "] }";
+}
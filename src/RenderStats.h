@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hot-path counters cost a few increments per ray; builds without RAYTRACER_STATS
+// drop every RENDER_STAT statement.
+#ifdef RAYTRACER_STATS
+#define RENDER_STAT(...) __VA_ARGS__
+inline constexpr bool renderCountersEnabled = true;
+#else
+#define RENDER_STAT(...)
+inline constexpr bool renderCountersEnabled = false;
+#endif
+
+// Counts for one frame. Every worker fills its own copy; Renderer merges them
+// once the frame is done, so nothing is shared on the hot path.
+struct RenderCounters {
+	static constexpr uint32_t maxPathLength = 8; // longer paths land in the last bucket
+	uint64_t primaryRays = 0;
+	uint64_t secondaryRays = 0;
+	uint64_t shadowRays = 0; // any-hit visibility queries, not counted in misses
+	uint64_t misses = 0; // rays of either kind that left the scene
+	uint64_t nodesVisited = 0;
+	uint64_t sphereTests = 0; // ray-sphere tests, counting every SIMD lane
+	uint64_t pathLengths[maxPathLength + 1] = {}; // samples by the number of surfaces hit
+	uint64_t surfaceHits = 0; // summed over paths, unlike pathLengths not clamped
+	uint64_t rouletteTerminations = 0; // paths ended by Russian roulette
+
+	void Merge(const RenderCounters& other) noexcept;
+	double MeanPathLength() const noexcept; // surfaces hit per path
+};
+
+struct RenderStats {
+	struct Worker {
+		float busyTime = 0.0f; // ms spent rendering tiles
+		float idleTime = 0.0f; // ms of the frame spent waiting or stealing
+		uint32_t tiles = 0;
+	};
+	bool countersEnabled = false; // false when built without RAYTRACER_STATS
+	uint64_t frameIndex = 0;
+	float frameTime = 0.0f; // ms
+	RenderCounters counters;
+	std::vector<Worker> workers;
+
+	// The whole frame as one line of JSON.
+	std::string ToJson() const;
+};
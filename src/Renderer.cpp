@@ -1,161 +1,1103 @@
 #include "Renderer.h"
 #include "VectorUtils.h"
-#include "imgui.h"
+#include "Profiler.h"
+#include "Bsdf.h"
 
 #include <chrono>
-#include <numeric>
-#include <ranges>
 #include <algorithm>
-#include <execution>
+#include <cstring>
+#include <iterator>
+#include <limits>
 
-Renderer::Renderer(Graphics& gfx)
+namespace
+{
+	// Black through blue, magenta, red and yellow to white as t goes from 0 to 1.
+	DirectX::XMFLOAT4 HeatColor(float t)
+	{
+		static constexpr DirectX::XMFLOAT3 stops[] = {
+			{ 0.0f, 0.0f, 0.0f }, { 0.1f, 0.1f, 0.8f }, { 0.8f, 0.1f, 0.7f }, { 1.0f, 0.2f, 0.1f }, { 1.0f, 0.9f, 0.1f }, { 1.0f, 1.0f, 1.0f }
+		};
+		constexpr int nSegments = (int)std::size(stops) - 1;
+		const float position = std::clamp(t, 0.0f, 1.0f) * nSegments;
+		const int segment = std::min((int)position, nSegments - 1);
+		const float f = position - (float)segment;
+		const DirectX::XMFLOAT3& a = stops[segment];
+		const DirectX::XMFLOAT3& b = stops[segment + 1];
+		return { a.x + (b.x - a.x) * f, a.y + (b.y - a.y) * f, a.z + (b.z - a.z) * f, 1.0f };
+	}
+
+	// 1 - cos of the half-angle a sphere subtends, 0 from inside it. Written with
+	// sin^2 so a small, distant sphere does not cancel to 0.
+	float ConeOneMinusCos(float radius, float distanceSq)
+	{
+		const float sin2 = radius * radius / distanceSq;
+		if (!(sin2 < 1.0f)) {
+			return 0.0f;
+		}
+		return sin2 / (1.0f + sqrtf(1.0f - sin2));
+	}
+
+	// Veach's power heuristic, beta = 2.
+	float PowerHeuristic(float pdf, float otherPdf)
+	{
+		const float a = pdf * pdf;
+		const float b = otherPdf * otherPdf;
+		return a + b > 0.0f ? a / (a + b) : 0.0f;
+	}
+}
+
+Renderer::Renderer(int width, int height)
 	:
-	m_Width(gfx.GetWidth()),
-	m_Height(gfx.GetHeight()),
-	m_AccumulationData(new DirectX::XMFLOAT4[m_Width * m_Height])
+	m_Sampler(Sampler::Create(m_SamplerType))
 {
-	gfx.SetTextureClearColor(clearColor);
-	m_VerticalIter.resize(m_Height);
-	m_HorizontalIter.resize(m_Width);
-	std::ranges::iota(m_VerticalIter, 0);
-	std::ranges::iota(m_HorizontalIter, 0);
+	m_Settings.threadCount = (int)m_ThreadPool.GetThreadCount();
+	Resize(width, height);
 }
 
-void Renderer::Render(Graphics& gfx, const Scene& scene, const Camera& camera)
+void Renderer::Resize(int width, int height)
 {
+	if (width == m_Width && height == m_Height) {
+		return;
+	}
+	m_Width = width;
+	m_Height = height;
+
+	const size_t nPixels = (size_t)m_Width * m_Height;
+	m_AccumulationData.reset(new DirectX::XMFLOAT4[nPixels]);
+	m_LuminanceSquaredData.reset(new float[nPixels]);
+	m_SampleIndexData.reset(new uint32_t[nPixels]);
+	m_DepthData.reset(new float[nPixels]);
+	m_NormalData.reset(new DirectX::XMFLOAT3[nPixels]);
+	m_HistoryAccumulationData.reset(new DirectX::XMFLOAT4[nPixels]);
+	m_HistoryLuminanceSquaredData.reset(new float[nPixels]);
+	m_HistoryDepthData.reset(new float[nPixels]);
+	m_HistoryNormalData.reset(new DirectX::XMFLOAT3[nPixels]);
+	m_CostData.reset(new PixelCost[nPixels]);
+	m_PrimaryObjectData.reset(new int32_t[nPixels]);
+	m_PrimaryLightData.reset(new DirectX::XMFLOAT3[nPixels]);
+
+	// Nothing measured at the old size carries over.
+	m_TimePerPixel = 0.0f;
+	m_CameraMoved = false;
+	ResetFrameIndex();
+}
+
+void Renderer::Render(Framebuffer& framebuffer, const Scene& scene, const Camera& camera)
+{
+	PROFILE_ZONE("Render");
+
+	// A different scene, or one that grew or shrank, is built from scratch; edits
+	// to the current one update only the spheres they touched.
+	IndexRange editedSpheres;
+	if (scene.GetId() != m_SceneId || scene.spheres.size() != m_GeometrySphereCount || scene.materials.size() != m_SceneMaterialCount) {
+		m_GeometryDirty = true;
+		ResetFrameIndex();
+		m_LightBVH.Build(scene);
+	}
+	else if (scene.GetVersion() != m_SceneVersion) {
+		const SceneChanges changes = scene.GetChanges(m_SceneVersion);
+		editedSpheres = changes.spheres;
+		m_PrimaryCacheValid = false;
+		m_EditResetCoverage = 1.0f;
+		const bool lightsEdited = EditsLights(scene, changes);
+		if (lightsEdited || !ResetEditedBlocks(scene, changes, camera)) {
+			ResetFrameIndex();
+		}
+		if (lightsEdited) {
+			m_LightBVH.Build(scene);
+		}
+	}
+	if (scene.environment != m_Environment) {
+		m_Environment = scene.environment;
+		ResetFrameIndex();
+	}
+	m_SceneId = scene.GetId();
+	m_SceneVersion = scene.GetVersion();
+	m_SceneMaterialCount = scene.materials.size();
+
 	m_ActiveScene = &scene;
 	m_ActiveCamera = &camera;
 
+	if (m_Settings.sampler != m_SamplerType) {
+		m_SamplerType = m_Settings.sampler;
+		m_Sampler = Sampler::Create(m_SamplerType);
+		ResetFrameIndex();
+	}
+
+	if (!m_GeometryDirty && !editedSpheres.Empty()) {
+		PROFILE_ZONE("Refit acceleration structure");
+		for (uint32_t i = editedSpheres.first; i < editedSpheres.last; ++i) {
+			m_Spheres.Set(i, scene.spheres[i]);
+		}
+		m_BVH.Refit(scene, editedSpheres);
+		m_PrimaryCacheValid = false;
+		m_GeometryDirty = m_BVH.GetSahCost() > maxRefitCost * m_BVH.GetBuildStats().sahCost;
+	}
+
+	if (m_GeometryDirty) {
+		PROFILE_ZONE("Build acceleration structure");
+		m_Spheres.Build(scene.spheres);
+		m_BVH.Build(scene);
+		m_GeometrySphereCount = scene.spheres.size();
+		m_GeometryDirty = false;
+		m_PrimaryCacheValid = false;
+	}
+
+	// History can only follow the camera from a fully traced, accumulated frame;
+	// anything else falls back to discarding it.
+	m_ReprojectThisFrame = false;
+	if (m_CameraMoved) {
+		m_CameraMoved = false;
+		m_PrimaryCacheValid = false;
+		if (m_Settings.reproject && m_Settings.accumulate && m_FrameIndex > 1u && m_Stride == 1) {
+			std::swap(m_AccumulationData, m_HistoryAccumulationData);
+			std::swap(m_LuminanceSquaredData, m_HistoryLuminanceSquaredData);
+			std::swap(m_DepthData, m_HistoryDepthData);
+			std::swap(m_NormalData, m_HistoryNormalData);
+			// Costs describe the rays of the old view; they start over with the new one.
+			std::fill_n(m_CostData.get(), (size_t)m_Width * m_Height, PixelCost{});
+			m_ReprojectedPixels.store(0, std::memory_order_relaxed);
+			m_ReprojectThisFrame = true;
+		}
+		else {
+			ResetFrameIndex();
+		}
+	}
+
 	if (m_FrameIndex == 1u) {
 		memset(m_AccumulationData.get(), 0, sizeof(DirectX::XMFLOAT4) * m_Width * m_Height);
+		memset(m_LuminanceSquaredData.get(), 0, sizeof(float) * m_Width * m_Height);
+		memset(m_SampleIndexData.get(), 0, sizeof(uint32_t) * m_Width * m_Height);
+		std::fill_n(m_CostData.get(), (size_t)m_Width * m_Height, PixelCost{});
+	}
+	m_CollectCost = m_Settings.collectCost || IsCostDisplay(m_Settings.displayMode);
+
+	// A reset starts coarse, at a resolution that fits the motion budget, and each
+	// following frame halves the stride until every pixel is traced again.
+	if (m_FrameIndex == 1u) {
+		m_Stride = ChooseMotionStride();
+	}
+	else {
+		m_Stride = std::max(m_Stride / 2, 1u);
+	}
+
+	ScheduleSamples();
+
+	// Jittered or coarse frames trace rays the cache does not hold. It is filled
+	// only by a frame that traces every pixel, which adaptive sampling may skip.
+	const bool fullFrame = m_Stride == 1 && m_ActiveBlocks == m_BlockSamples.size();
+	if (m_Settings.antiAliasing || m_Stride != 1 || memcmp(&lightDir, &m_PrimaryLightDir, sizeof(lightDir)) != 0) {
+		m_PrimaryCacheValid = false;
 	}
+	m_FillPrimaryCache = !m_PrimaryCacheValid && !m_Settings.antiAliasing && fullFrame;
 
 	auto start = std::chrono::high_resolution_clock::now();
 
-#define MT 1
-#ifdef MT
-	std::for_each(std::execution::par, m_VerticalIter.begin(), m_VerticalIter.end(),
-		[this, &gfx](uint64_t y) {
-			std::for_each(std::execution::par, m_HorizontalIter.begin(), m_HorizontalIter.end(),
-				[this, y, &gfx](uint64_t x) {
-					auto color = PerPixel(x, y);
-					color.w = 1.0f;
+	m_ThreadPool.SetThreadCount((uint32_t)m_Settings.threadCount);
 
-					m_AccumulationData[x + y * m_Width] = Utils::Add(m_AccumulationData[x + y * m_Width], color);
-					color = Utils::Scale(m_AccumulationData[x + y * m_Width], (1.0f / (float)m_FrameIndex));
+	const uint32_t tileExtent = m_Settings.tileSize * m_Stride;
+	const uint32_t tilesX = (m_Width + tileExtent - 1) / tileExtent;
+	const uint32_t tilesY = (m_Height + tileExtent - 1) / tileExtent;
+	m_TileTimes.resize((size_t)tilesX * tilesY);
+	m_RayCount.store(0, std::memory_order_relaxed);
+	m_WorkerStats.assign(m_ThreadPool.GetThreadCount(), WorkerStats{});
 
-					color = Utils::Clamp(color, 0.0f, 1.0f);
-					gfx.PutPixel((int)x, (int)y, color);
-				}
-			);
+	{
+		PROFILE_ZONE("Trace tiles");
+		m_ThreadPool.ParallelFor(tilesX * tilesY, [this, &framebuffer, tilesX](uint32_t tile, uint32_t worker) {
+			RenderTile(framebuffer, tile % tilesX, tile / tilesX, worker);
+		});
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	lastRenderTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+	if (IsCostDisplay(m_Settings.displayMode)) {
+		m_CostRange = 0.0f;
+		for (size_t pixel = 0; pixel < (size_t)m_Width * m_Height; ++pixel) {
+			m_CostRange = std::max(m_CostRange, MeanCost(m_CostData[pixel], m_Settings.displayMode));
+		}
+	}
+
+	m_FrameStats.countersEnabled = renderCountersEnabled;
+	m_FrameStats.frameIndex = m_FrameIndex;
+	m_FrameStats.frameTime = lastRenderTime;
+	m_FrameStats.counters = {};
+	m_FrameStats.workers.resize(m_WorkerStats.size());
+	for (size_t i = 0; i < m_WorkerStats.size(); ++i) {
+		const WorkerStats& worker = m_WorkerStats[i];
+		m_FrameStats.counters.Merge(worker.counters);
+		m_FrameStats.workers[i] = { worker.busyTime, std::max(lastRenderTime - worker.busyTime, 0.0f), worker.tiles };
+	}
+
+	if (m_FillPrimaryCache) {
+		m_PrimaryLightDir = lightDir;
+		m_PrimaryCacheValid = true;
+	}
+
+	DirectX::XMStoreFloat4x4(&m_PreviousViewProjection, DirectX::XMMatrixMultiply(camera.GetView(), camera.GetProjection()));
+	DirectX::XMStoreFloat3(&m_PreviousPosition, camera.GetPosition());
+
+	if (m_FrameIndex == 1u) {
+		const float tracedPixels = (float)((m_Width + m_Stride - 1) / m_Stride) * (float)((m_Height + m_Stride - 1) / m_Stride);
+		m_TimePerPixel = lastRenderTime / tracedPixels;
+	}
+
+	// Once every block has converged the frame index stops, so the image and the
+	// sample sequence stay put until something resets accumulation.
+	if (!m_Settings.accumulate)
+		m_FrameIndex = 1u;
+	else if (m_ActiveBlocks > 0)
+		++m_FrameIndex;
+}
+
+const DirectX::XMFLOAT4& Renderer::GetClearColor() const noexcept
+{
+	return clearColor;
+}
+
+Renderer::Settings& Renderer::GetSettings() noexcept
+{
+	return m_Settings;
+}
+
+const Renderer::Settings& Renderer::GetSettings() const noexcept
+{
+	return m_Settings;
+}
+
+float Renderer::GetLastRenderTime() const noexcept
+{
+	return lastRenderTime;
+}
+
+uint64_t Renderer::GetLastRayCount() const noexcept
+{
+	return m_RayCount.load(std::memory_order_relaxed);
+}
+
+const RenderStats& Renderer::GetLastFrameStats() const noexcept
+{
+	return m_FrameStats;
+}
+
+uint32_t Renderer::GetThreadCount() const noexcept
+{
+	return m_ThreadPool.GetThreadCount();
+}
+
+void Renderer::ResetFrameIndex()
+{
+	m_FrameIndex = 1u;
+	m_PrimaryCacheValid = false;
+}
+
+void Renderer::OnCameraMoved()
+{
+	m_CameraMoved = true;
+}
+
+void Renderer::ResolveRadiance(Framebuffer& framebuffer) const
+{
+	PROFILE_ZONE("Resolve radiance");
+	for (int y = 0; y < m_Height; ++y) {
+		for (int x = 0; x < m_Width; ++x) {
+			const DirectX::XMFLOAT4& sum = m_AccumulationData[x + (size_t)y * m_Width];
+			framebuffer.PutPixel(x, y, sum.w > 0.0f ? Utils::Scale(sum, 1.0f / sum.w) : DirectX::XMFLOAT4{ 0.0f, 0.0f, 0.0f, 1.0f });
 		}
-	);
-#else
+	}
+}
+
+void Renderer::ResolveCost(Framebuffer& framebuffer) const
+{
 	for (int y = 0; y < m_Height; ++y) {
 		for (int x = 0; x < m_Width; ++x) {
+			const PixelCost& cost = m_CostData[x + (size_t)y * m_Width];
+			const float scale = cost.samples > 0.0f ? 1.0f / cost.samples : 0.0f;
+			framebuffer.PutPixel(x, y, { cost.sphereTests * scale, cost.bounces * scale, cost.time * scale, 1.0f });
+		}
+	}
+}
 
-			auto color = PerPixel(x, y);
-			color.w = 1.0f;
+void Renderer::RenderTile(Framebuffer& framebuffer, uint32_t tileX, uint32_t tileY, uint32_t worker)
+{
+	auto start = std::chrono::high_resolution_clock::now();
 
-			m_AccumulationData[x + y * m_Width] = Utils::Add(m_AccumulationData[x + y * m_Width], color);
-			color = Utils::Scale(m_AccumulationData[x + y * m_Width], (1.0f / (float)m_FrameIndex));
+	// At a coarse stride a tile covers the same number of traced pixels over a larger area.
+	const uint32_t tileExtent = m_Settings.tileSize * m_Stride;
+	const uint32_t blockExtent = RayPacket::tileSize * m_Stride;
+	const uint64_t x0 = (uint64_t)tileX * tileExtent;
+	const uint64_t y0 = (uint64_t)tileY * tileExtent;
+	const uint64_t x1 = std::min<uint64_t>(x0 + tileExtent, m_Width);
+	const uint64_t y1 = std::min<uint64_t>(y0 + tileExtent, m_Height);
+	PROFILE_ZONE("Tile", Profiler::Region{ (int32_t)x0, (int32_t)y0, (int32_t)(x1 - x0), (int32_t)(y1 - y0) });
 
-			color = Utils::Clamp(color, 0.0f, 1.0f);
-			gfx.PutPixel(x, y, color);
+	// Tiles are a whole number of packets, so primary rays stay in coherent 8x8 blocks.
+	WorkerStats& stats = m_WorkerStats[worker];
+	for (uint64_t y = y0; y < y1; y += blockExtent) {
+		for (uint64_t x = x0; x < x1; x += blockExtent) {
+			RenderBlock(framebuffer, x, y, m_Stride, stats.counters);
 		}
 	}
-#endif
+
 	auto end = std::chrono::high_resolution_clock::now();
+	const float tileTime = std::chrono::duration<float, std::milli>(end - start).count();
+	m_TileTimes[tileX + tileY * ((m_Width + tileExtent - 1) / tileExtent)] = tileTime;
+	stats.busyTime += tileTime;
+	++stats.tiles;
+}
 
-	lastRenderTime = std::chrono::duration<float, std::milli>(end - start).count();
+void Renderer::RenderBlock(Framebuffer& framebuffer, uint64_t x0, uint64_t y0, uint32_t stride, RenderCounters& counters)
+{
+	const uint64_t blockExtent = (uint64_t)RayPacket::tileSize * stride;
+	const uint64_t x1 = std::min<uint64_t>(x0 + blockExtent, m_Width);
+	const uint64_t y1 = std::min<uint64_t>(y0 + blockExtent, m_Height);
 
-	if (m_Accumulate)
-		++m_FrameIndex;
-	else
-		m_FrameIndex = 1u;
+	// Adaptive scheduling works on full-resolution blocks; coarse frames trace everything once.
+	const bool fullResolution = stride == 1;
+	const uint32_t blocksX = (m_Width + RayPacket::tileSize - 1) / RayPacket::tileSize;
+	const size_t block = x0 / RayPacket::tileSize + (y0 / RayPacket::tileSize) * blocksX;
+	const uint32_t nSamples = fullResolution ? m_BlockSamples[block] : 1u;
+
+	if (nSamples > 0) {
+		RayPacket packet;
+		HitPayload primaryHits[RayPacket::maxSize];
+		PixelCost primaryCosts[RayPacket::maxSize] = {};
+		uint32_t nRays = 0;
+		if (m_PrimaryCacheValid) {
+			GeneratePrimaryRays(x0, y0, stride, packet);
+		}
+		else {
+			TracePrimaryRays(x0, y0, stride, packet, primaryHits, counters, m_CollectCost ? primaryCosts : nullptr);
+			nRays = (uint32_t)(((x1 - x0 + stride - 1) / stride) * ((y1 - y0 + stride - 1) / stride));
+			RENDER_STAT(counters.primaryRays += nRays);
+		}
+
+		uint32_t reprojected = 0;
+		for (uint64_t y = y0; y < y1; y += stride) {
+			for (uint64_t x = x0; x < x1; x += stride) {
+				const size_t pixel = x + y * m_Width;
+				const uint64_t lane = (x - x0) / stride + (y - y0) / stride * RayPacket::tileSize;
+				const Ray primaryRay = { packet.origin, { packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane] } };
+				HitPayload& primaryHit = primaryHits[lane];
+				DirectX::XMFLOAT3 primaryLight;
+
+				if (m_PrimaryCacheValid) {
+					primaryHit = LoadPrimaryHit(pixel, primaryRay);
+					primaryLight = m_PrimaryLightData[pixel];
+				}
+				else {
+					if (m_ReprojectThisFrame && ReprojectPixel(x, y, primaryHit)) {
+						++reprojected;
+					}
+					RENDER_STAT(counters.misses += primaryHit.hitDistance < 0.0f);
+					primaryLight = { 0.0f, 0.0f, 0.0f };
+					if (primaryHit.hitDistance >= 0.0f) {
+						uint32_t shadowTests = 0;
+						const Material& material = m_ActiveScene->materials[m_ActiveScene->spheres[primaryHit.objectIndex].materialIndex];
+						primaryLight = DirectLight(primaryHit, material, Utils::Negate(primaryRay.direction), nRays, counters, m_CollectCost ? &shadowTests : nullptr);
+						primaryCosts[lane].sphereTests += (float)shadowTests;
+					}
+					m_DepthData[pixel] = primaryHit.hitDistance;
+					m_NormalData[pixel] = primaryHit.hitDistance >= 0.0f ? primaryHit.WorldNormal : DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
+					if (m_FillPrimaryCache) {
+						m_PrimaryObjectData[pixel] = primaryHit.objectIndex;
+						m_PrimaryLightData[pixel] = primaryLight;
+					}
+				}
+
+				// Converged pixels in a block that is still active keep their estimate.
+				if (fullResolution && m_Settings.adaptive && PixelError(pixel) <= 1.0f) {
+					continue;
+				}
+
+				// Every sample this frame shares the block's primary ray, including its jitter.
+				PixelCost* cost = m_CollectCost ? &primaryCosts[lane] : nullptr;
+				const auto samplesStart = m_CollectCost ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+				for (uint32_t s = 0; s < nSamples; ++s) {
+					auto color = PerPixel(x, y, m_SampleIndexData[pixel]++, primaryRay, primaryHit, primaryLight, nRays, counters, cost);
+					color.w = 1.0f;
+
+					const float luminance = Utils::Luminance(Utils::ToFloat3(color));
+					m_AccumulationData[pixel] = Utils::Add(m_AccumulationData[pixel], color);
+					m_LuminanceSquaredData[pixel] += luminance * luminance;
+				}
+				if (cost) {
+					PixelCost& total = m_CostData[pixel];
+					total.sphereTests += cost->sphereTests;
+					total.bounces += cost->bounces;
+					total.time += cost->time + std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - samplesStart).count();
+					total.samples += (float)nSamples;
+				}
+			}
+		}
+		if (reprojected > 0) {
+			m_ReprojectedPixels.fetch_add(reprojected, std::memory_order_relaxed);
+		}
+		m_RayCount.fetch_add(nRays, std::memory_order_relaxed);
+	}
+
+	float blockError = 0.0f;
+	for (uint64_t y = y0; y < y1; ++y) {
+		for (uint64_t x = x0; x < x1; ++x) {
+			const size_t pixel = x + y * m_Width;
+			// Pixels without samples yet are upsampled from the traced pixel of their cell.
+			const size_t source = m_AccumulationData[pixel].w > 0.0f ? pixel : (x - x % stride) + (y - y % stride) * m_Width;
+			framebuffer.PutPixel((int)x, (int)y, ResolvePixel(source));
+			if (fullResolution) {
+				blockError = std::max(blockError, PixelError(pixel));
+			}
+		}
+	}
+	if (fullResolution) {
+		m_BlockErrors[block] = blockError;
+	}
 }
 
-void Renderer::RenderUI()
+void Renderer::ScheduleSamples()
 {
-	ImGui::Begin("Settings");
+	PROFILE_ZONE("Schedule samples");
 
-	ImGui::Text("Last render: %.3fms", lastRenderTime);
-	ImGui::SliderFloat3("Light direction", &lightDir.x, -1.0f, 1.0f);
+	const uint32_t blocksX = (m_Width + RayPacket::tileSize - 1) / RayPacket::tileSize;
+	const uint32_t blocksY = (m_Height + RayPacket::tileSize - 1) / RayPacket::tileSize;
+	const size_t nBlocks = (size_t)blocksX * blocksY;
 
-	ImGui::Separator();
+	// Errors measured in the previous view say nothing about where pixels land now.
+	if (m_FrameIndex == 1u || m_ReprojectThisFrame || m_BlockErrors.size() != nBlocks) {
+		m_BlockErrors.assign(nBlocks, INFINITY);
+	}
+	if (!m_Settings.adaptive || m_FrameIndex == 1u) {
+		m_BlockSamples.assign(nBlocks, 1u);
+		m_ActiveBlocks = (uint32_t)nBlocks;
+		return;
+	}
 
-	ImGui::Checkbox("Accumulate", &m_Accumulate);
-	if (ImGui::Button("Reset")) {
-		ResetFrameIndex();
+	// Keep the budget of one sample per pixel per frame, and hand it to the
+	// unconverged blocks in proportion to how far they are from the target.
+	constexpr float maxWeight = 4.0f;
+	constexpr float blockPixels = (float)(RayPacket::tileSize * RayPacket::tileSize);
+	float weightSum = 0.0f;
+	for (float error : m_BlockErrors) {
+		if (error > 1.0f) {
+			weightSum += std::min(error, maxWeight) * blockPixels;
+		}
 	}
 
-	ImGui::End();
+	const float budget = (float)m_Width * (float)m_Height;
+	m_BlockSamples.resize(nBlocks);
+	m_ActiveBlocks = 0;
+	for (size_t block = 0; block < nBlocks; ++block) {
+		const float error = m_BlockErrors[block];
+		if (error <= 1.0f) {
+			m_BlockSamples[block] = 0;
+			continue;
+		}
+		const float share = budget * std::min(error, maxWeight) / weightSum;
+		m_BlockSamples[block] = std::clamp((uint32_t)(share + 0.5f), 1u, (uint32_t)m_Settings.maxSamplesPerFrame);
+		++m_ActiveBlocks;
+	}
 }
 
-void Renderer::ResetFrameIndex()
+uint32_t Renderer::ChooseMotionStride() const
 {
-	m_FrameIndex = 1u;
+	// Only worth it while accumulating; otherwise every frame would be coarse.
+	if (!m_Settings.reduceResolution || !m_Settings.accumulate || m_TimePerPixel <= 0.0f) {
+		return 1u;
+	}
+	const float pixels = (float)m_Width * (float)m_Height;
+	for (uint32_t stride : { 1u, 2u }) {
+		if (pixels / (float)(stride * stride) * m_TimePerPixel <= m_Settings.motionBudget) {
+			return stride;
+		}
+	}
+	return 4u;
 }
 
-DirectX::XMFLOAT4 Renderer::PerPixel(uint64_t x, uint64_t y)
+float Renderer::PixelError(size_t pixel) const
 {
-	Ray ray;
-	DirectX::XMStoreFloat3(&ray.origin, m_ActiveCamera->GetPosition());
-	ray.direction = m_ActiveCamera->GetRayDirections()[x + y * m_Width];
+	// Standard error of the mean luminance relative to the mean, in units of the
+	// target. The small offset keeps near-black pixels from never converging.
+	const DirectX::XMFLOAT4& sum = m_AccumulationData[pixel];
+	const float n = sum.w;
+	if (n < (float)std::max(m_Settings.minSamples, 2)) {
+		return INFINITY;
+	}
+	const float mean = Utils::Luminance(Utils::ToFloat3(sum)) / n;
+	const float variance = std::max(m_LuminanceSquaredData[pixel] / n - mean * mean, 0.0f) * n / (n - 1.0f);
+	return sqrtf(variance / n) / ((mean + 0.01f) * m_Settings.targetNoise);
+}
+
+DirectX::XMFLOAT4 Renderer::ResolvePixel(size_t pixel) const
+{
+	const DirectX::XMFLOAT4& sum = m_AccumulationData[pixel];
+
+	switch (m_Settings.displayMode) {
+	case DisplayMode::Noise: {
+		// Green at the target, red at twice the target or while under the minimum sample count.
+		const float t = std::clamp(PixelError(pixel) - 1.0f, 0.0f, 1.0f);
+		return { t, 1.0f - t, 0.0f, 1.0f };
+	}
+	case DisplayMode::SampleCount: {
+		const float maxSamples = (float)m_FrameIndex * (float)(m_Settings.adaptive ? m_Settings.maxSamplesPerFrame : 1);
+		const float t = log2f(1.0f + sum.w) / log2f(1.0f + maxSamples);
+		return { t, t, t, 1.0f };
+	}
+	case DisplayMode::IntersectionTests:
+	case DisplayMode::Bounces:
+	case DisplayMode::Time: {
+		// Logarithmic, so a few pathological pixels do not flatten the rest of the map.
+		const float cost = MeanCost(m_CostData[pixel], m_Settings.displayMode);
+		return HeatColor(log2f(1.0f + cost) / log2f(1.0f + std::max(m_CostRange, 1.0f)));
+	}
+	case DisplayMode::Color:
+	default:
+		break;
+	}
+
+	if (sum.w == 0.0f) {
+		return { 0.0f, 0.0f, 0.0f, 1.0f };
+	}
+	return Utils::DisplayTransform(Utils::Scale(sum, 1.0f / sum.w));
+}
+
+bool Renderer::EditsLights(const Scene& scene, const SceneChanges& changes) const
+{
+	// m_LightBVH still holds the emitters from before the edit.
+	for (uint32_t i = changes.spheres.first; i < changes.spheres.last; ++i) {
+		if (m_LightBVH.IsLight(i) || scene.materials[scene.spheres[i].materialIndex].IsEmissive()) {
+			return true;
+		}
+	}
+	for (uint32_t i = changes.materials.first; i < changes.materials.last; ++i) {
+		if (scene.materials[i].IsEmissive()) {
+			return true;
+		}
+	}
+	if (!changes.materials.Empty()) {
+		for (const uint32_t light : m_LightBVH.GetLights()) {
+			const uint32_t material = (uint32_t)scene.spheres[light].materialIndex;
+			if (material >= changes.materials.first && material < changes.materials.last) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool Renderer::ResetEditedBlocks(const Scene& scene, const SceneChanges& changes, const Camera& camera)
+{
+	PROFILE_ZONE("Reset edited blocks");
+
+	// Screen bounds need the view the accumulated samples were taken from, and
+	// whole-frame states (a reset, a coarse stride) have nothing to keep anyway.
+	if (!m_Settings.localEditReset || !m_Settings.accumulate || m_CameraMoved || m_FrameIndex == 1u || m_Stride != 1) {
+		return false;
+	}
+
+	const uint32_t blocksX = (m_Width + RayPacket::tileSize - 1) / RayPacket::tileSize;
+	const uint32_t blocksY = (m_Height + RayPacket::tileSize - 1) / RayPacket::tileSize;
+	std::vector<uint8_t> blocks((size_t)blocksX * blocksY, 0);
+	const DirectX::XMMATRIX viewProjection = DirectX::XMMatrixMultiply(camera.GetView(), camera.GetProjection());
+
+	// Edited spheres where they were, still in the SoA mirror, and where they are now.
+	for (uint32_t i = changes.spheres.first; i < changes.spheres.last; ++i) {
+		DirectX::XMFLOAT3 center;
+		float radius;
+		m_Spheres.GetBounds(i, center, radius);
+		if (!MarkScreenBounds(center, radius, viewProjection, blocks) ||
+			!MarkScreenBounds(scene.spheres[i].position, std::abs(scene.spheres[i].radius), viewProjection, blocks)) {
+			return false;
+		}
+	}
+	// Edited materials show wherever a sphere using them does.
+	if (!changes.materials.Empty()) {
+		for (const Sphere& sphere : scene.spheres) {
+			const uint32_t material = (uint32_t)sphere.materialIndex;
+			if (material >= changes.materials.first && material < changes.materials.last &&
+				!MarkScreenBounds(sphere.position, std::abs(sphere.radius), viewProjection, blocks)) {
+				return false;
+			}
+		}
+	}
+
+	const size_t marked = (size_t)std::count(blocks.begin(), blocks.end(), (uint8_t)1);
+	if ((float)marked > maxEditResetCoverage * (float)blocks.size()) {
+		return false;
+	}
+	m_EditResetCoverage = (float)marked / (float)blocks.size();
+
+	const float historyLimit = (float)m_Settings.editHistoryLimit;
+	for (int y = 0; y < m_Height; ++y) {
+		for (int x = 0; x < m_Width; ++x) {
+			const size_t pixel = (size_t)x + (size_t)y * m_Width;
+			const size_t block = x / RayPacket::tileSize + (y / RayPacket::tileSize) * blocksX;
+			DirectX::XMFLOAT4& sum = m_AccumulationData[pixel];
+			if (blocks[block]) {
+				sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+				m_LuminanceSquaredData[pixel] = 0.0f;
+				m_CostData[pixel] = {};
+			}
+			else if (sum.w > historyLimit) {
+				const float scale = historyLimit / sum.w;
+				sum = Utils::Scale(sum, scale);
+				sum.w = historyLimit;
+				m_LuminanceSquaredData[pixel] *= scale;
+			}
+		}
+	}
+	for (size_t block = 0; block < blocks.size(); ++block) {
+		if (blocks[block] && block < m_BlockErrors.size()) {
+			m_BlockErrors[block] = INFINITY;
+		}
+	}
+	return true;
+}
+
+bool Renderer::MarkScreenBounds(const DirectX::XMFLOAT3& center, float radius, DirectX::FXMMATRIX viewProjection, std::vector<uint8_t>& blocks) const
+{
+	// Project the corners of the sphere's box. A corner behind the camera leaves
+	// the screen rectangle unbounded.
+	float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+	for (int corner = 0; corner < 8; ++corner) {
+		const DirectX::XMVECTOR clip = DirectX::XMVector4Transform(DirectX::XMVectorSet(
+			center.x + (corner & 1 ? radius : -radius),
+			center.y + (corner & 2 ? radius : -radius),
+			center.z + (corner & 4 ? radius : -radius), 1.0f), viewProjection);
+		const float w = DirectX::XMVectorGetW(clip);
+		if (w <= 0.0f) {
+			return false;
+		}
+		// Same pixel mapping as ReprojectPixel.
+		const float x = (DirectX::XMVectorGetX(clip) / w + 1.0f) * 0.5f * (float)m_Width;
+		const float y = (DirectX::XMVectorGetY(clip) / w + 1.0f) * 0.5f * (float)m_Height;
+		minX = std::min(minX, x);
+		minY = std::min(minY, y);
+		maxX = std::max(maxX, x);
+		maxY = std::max(maxY, y);
+	}
+	// A pixel of margin covers anti-aliasing jitter.
+	if (maxX < -1.0f || maxY < -1.0f || minX > (float)m_Width + 1.0f || minY > (float)m_Height + 1.0f) {
+		return true;
+	}
+	const uint32_t blocksX = (m_Width + RayPacket::tileSize - 1) / RayPacket::tileSize;
+	const uint32_t blocksY = (m_Height + RayPacket::tileSize - 1) / RayPacket::tileSize;
+	const uint32_t x0 = (uint32_t)std::clamp(minX - 1.0f, 0.0f, (float)m_Width - 1.0f) / RayPacket::tileSize;
+	const uint32_t y0 = (uint32_t)std::clamp(minY - 1.0f, 0.0f, (float)m_Height - 1.0f) / RayPacket::tileSize;
+	const uint32_t x1 = std::min((uint32_t)std::clamp(maxX + 1.0f, 0.0f, (float)m_Width - 1.0f) / RayPacket::tileSize, blocksX - 1);
+	const uint32_t y1 = std::min((uint32_t)std::clamp(maxY + 1.0f, 0.0f, (float)m_Height - 1.0f) / RayPacket::tileSize, blocksY - 1);
+	for (uint32_t y = y0; y <= y1; ++y) {
+		std::fill(blocks.begin() + x0 + (size_t)y * blocksX, blocks.begin() + x1 + 1 + (size_t)y * blocksX, (uint8_t)1);
+	}
+	return true;
+}
+
+bool Renderer::IsCostDisplay(DisplayMode mode) noexcept
+{
+	return mode == DisplayMode::IntersectionTests || mode == DisplayMode::Bounces || mode == DisplayMode::Time;
+}
+
+float Renderer::MeanCost(const PixelCost& cost, DisplayMode mode) noexcept
+{
+	if (cost.samples == 0.0f) {
+		return 0.0f;
+	}
+	switch (mode) {
+	case DisplayMode::IntersectionTests:
+		return cost.sphereTests / cost.samples;
+	case DisplayMode::Bounces:
+		return cost.bounces / cost.samples;
+	case DisplayMode::Time:
+		return cost.time / cost.samples;
+	default:
+		return 0.0f;
+	}
+}
+
+void Renderer::GeneratePrimaryRays(uint64_t x0, uint64_t y0, uint32_t stride, RayPacket& packet) const
+{
+	DirectX::XMStoreFloat3(&packet.origin, m_ActiveCamera->GetPosition());
+	packet.count = RayPacket::maxSize;
+
+	// Lanes outside the image repeat the edge pixel so the packet stays full.
+	alignas(32) float pixelX[RayPacket::maxSize];
+	alignas(32) float pixelY[RayPacket::maxSize];
+	for (uint32_t i = 0; i < RayPacket::maxSize; ++i) {
+		const uint64_t x = std::min<uint64_t>(x0 + (uint64_t)(i % RayPacket::tileSize) * stride, m_Width - 1);
+		const uint64_t y = std::min<uint64_t>(y0 + (uint64_t)(i / RayPacket::tileSize) * stride, m_Height - 1);
+		pixelX[i] = (float)x;
+		pixelY[i] = (float)y;
+		if (m_Settings.antiAliasing) {
+			const size_t pixel = x + y * m_Width;
+			const Sampler::PixelKey key = { (uint32_t)x, (uint32_t)y, (uint32_t)pixel };
+			const DirectX::XMFLOAT2 jitter = m_Sampler->Get2D(key, m_SampleIndexData[pixel], 0);
+			pixelX[i] += jitter.x;
+			pixelY[i] += jitter.y;
+		}
+		packet.hitDistance[i] = std::numeric_limits<float>::max();
+		packet.objectIndex[i] = -1;
+	}
+	m_ActiveCamera->GetRayGenerator().GetDirections(pixelX, pixelY, RayPacket::maxSize, packet.directionX, packet.directionY, packet.directionZ);
+}
+
+void Renderer::TracePrimaryRays(uint64_t x0, uint64_t y0, uint32_t stride, RayPacket& packet, HitPayload* hits, RenderCounters& counters, PixelCost* costs) const
+{
+	GeneratePrimaryRays(x0, y0, stride, packet);
+
+	if (costs) {
+		Ray ray;
+		ray.origin = packet.origin;
+		for (uint32_t i = 0; i < RayPacket::maxSize; ++i) {
+			const auto start = std::chrono::steady_clock::now();
+			uint32_t sphereTests = 0;
+			ray.direction = { packet.directionX[i], packet.directionY[i], packet.directionZ[i] };
+			hits[i] = TraceRay(ray, counters, &sphereTests);
+			costs[i] = { (float)sphereTests, 0.0f, std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - start).count(), 0.0f };
+		}
+		return;
+	}
+
+	if (!m_Settings.usePackets) {
+		Ray ray;
+		ray.origin = packet.origin;
+		for (uint32_t i = 0; i < RayPacket::maxSize; ++i) {
+			ray.direction = { packet.directionX[i], packet.directionY[i], packet.directionZ[i] };
+			hits[i] = TraceRay(ray, counters);
+		}
+		return;
+	}
+
+	if (m_Settings.useBVH) {
+		RENDER_STAT(BVH::TraversalStats traversal);
+		m_BVH.IntersectPacket(packet RENDER_STAT(, &traversal));
+		RENDER_STAT(counters.nodesVisited += traversal.nodesVisited);
+		RENDER_STAT(counters.sphereTests += traversal.spheresTested);
+	}
+	else {
+		m_Spheres.IntersectPacket(packet);
+		RENDER_STAT(counters.sphereTests += (uint64_t)m_GeometrySphereCount * RayPacket::maxSize);
+	}
+
+	for (uint32_t i = 0; i < RayPacket::maxSize; ++i) {
+		if (packet.objectIndex[i] < 0) {
+			hits[i] = Miss();
+			continue;
+		}
+		Ray ray;
+		ray.origin = packet.origin;
+		ray.direction = { packet.directionX[i], packet.directionY[i], packet.directionZ[i] };
+		hits[i] = ClosestHit(ray, packet.hitDistance[i], packet.objectIndex[i]);
+	}
+}
+
+bool Renderer::ReprojectPixel(uint64_t x, uint64_t y, const HitPayload& primaryHit)
+{
+	const size_t pixel = x + y * m_Width;
+	m_AccumulationData[pixel] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	m_LuminanceSquaredData[pixel] = 0.0f;
+
+	// Find where the first hit was on screen last frame. Misses project as
+	// directions, so the sky follows camera rotation but not translation.
+	const bool hit = primaryHit.hitDistance >= 0.0f;
+	const DirectX::XMFLOAT3 point = hit ? primaryHit.WorldPosition : m_ActiveCamera->GetRayGenerator().GetDirection((float)x, (float)y);
+	const DirectX::XMVECTOR clip = DirectX::XMVector4Transform(
+		DirectX::XMVectorSet(point.x, point.y, point.z, hit ? 1.0f : 0.0f), DirectX::XMLoadFloat4x4(&m_PreviousViewProjection));
+	const float w = DirectX::XMVectorGetW(clip);
+	if (w <= 0.0f) {
+		return false;
+	}
+	// Inverse of the pixel to NDC mapping that Camera::RecalculateRayGenerator bakes
+	// into RayGenerator (pixel (x, y) looks along corner + x * dx + y * dy).
+	const float historyX = (DirectX::XMVectorGetX(clip) / w + 1.0f) * 0.5f * (float)m_Width;
+	const float historyY = (DirectX::XMVectorGetY(clip) / w + 1.0f) * 0.5f * (float)m_Height;
+	if (!(historyX > -0.5f && historyX < (float)m_Width - 0.5f && historyY > -0.5f && historyY < (float)m_Height - 0.5f)) {
+		return false;
+	}
+	const size_t history = (size_t)(historyX + 0.5f) + (size_t)(historyY + 0.5f) * m_Width;
+
+	// Reject on disocclusion (the previous first hit was something else) or a normal mismatch.
+	const float historyDepth = m_HistoryDepthData[history];
+	if (hit) {
+		const float expectedDepth = Utils::Magnitude(Utils::Subtract(primaryHit.WorldPosition, m_PreviousPosition));
+		if (historyDepth < 0.0f || fabsf(expectedDepth - historyDepth) > reprojectionDepthTolerance * expectedDepth) {
+			return false;
+		}
+		if (Utils::Dot(primaryHit.WorldNormal, m_HistoryNormalData[history]) < reprojectionNormalTolerance) {
+			return false;
+		}
+	}
+	else if (historyDepth >= 0.0f) {
+		return false;
+	}
+
+	DirectX::XMFLOAT4 sum = m_HistoryAccumulationData[history];
+	float squaredSum = m_HistoryLuminanceSquaredData[history];
+	if (sum.w == 0.0f) {
+		return false;
+	}
+	// Limiting the carried weight lets view-dependent shading the tests cannot see wash out quickly.
+	if (sum.w > (float)m_Settings.historyLimit) {
+		const float scale = (float)m_Settings.historyLimit / sum.w;
+		sum = Utils::Scale(sum, scale);
+		sum.w = (float)m_Settings.historyLimit;
+		squaredSum *= scale;
+	}
+	m_AccumulationData[pixel] = sum;
+	m_LuminanceSquaredData[pixel] = squaredSum;
+	return true;
+}
+
+DirectX::XMFLOAT4 Renderer::PerPixel(uint64_t x, uint64_t y, uint32_t sampleIndex, const Ray& primaryRay, const HitPayload& primaryHit, const DirectX::XMFLOAT3& primaryLight, uint32_t& nRays, RenderCounters& counters, PixelCost* cost)
+{
+	Ray ray = primaryRay;
+
+	const Sampler::PixelKey pixel = { (uint32_t)x, (uint32_t)y, (uint32_t)(x + y * m_Width) };
 
 	DirectX::XMFLOAT3 color = { 0.0f, 0.0f, 0.0f };
-	float multiplier = 1.0f;
+	DirectX::XMFLOAT3 throughput = { 1.0f, 1.0f, 1.0f };
+	// Of the surface that continued the path, for MIS on emitter hits
+	float bsdfPdf = 0.0f;
+	DirectX::XMFLOAT3 previousNormal = { 0.0f, 0.0f, 0.0f };
 
-	int nBounces = 5;
-	for (int i = 0; i < nBounces; ++i) {
-		HitPayload payload = TraceRay(ray);
+	RENDER_STAT(uint32_t surfaces = 0);
+	uint32_t sphereTests = 0;
+	uint32_t bounces = 0;
+	const int maxDepth = std::max(m_Settings.maxDepth, 1);
+	for (int i = 0; i < maxDepth; ++i) {
+		// The first bounce was traced for the whole block by TracePrimaryRays.
+		if (i > 0) {
+			++nRays;
+			RENDER_STAT(++counters.secondaryRays);
+		}
+		HitPayload payload = i == 0 ? primaryHit : TraceRay(ray, counters, cost ? &sphereTests : nullptr);
 
 		if (payload.hitDistance < 0.0f) {
-			color = Utils::Add(color, Utils::Scale(Utils::ToFloat3(clearColor), multiplier));
+			RENDER_STAT(counters.misses += i > 0);
+			DirectX::XMFLOAT3 background = Utils::ToFloat3(clearColor);
+			if (m_Environment) {
+				background = m_Environment->Lookup(ray.direction);
+				// SampleEnvironment at the previous surface could have picked this direction too.
+				if (i > 0 && m_Settings.sampleLights) {
+					background = Utils::Scale(background, PowerHeuristic(bsdfPdf, m_Environment->Pdf(ray.direction)));
+				}
+			}
+			color = Utils::Add(color, Utils::Multiply(background, throughput));
 			break;
 		}
+		RENDER_STAT(++surfaces);
+		++bounces;
 
-		const float f = std::max(Utils::Dot(payload.WorldNormal, Utils::Normalize(Utils::Negate(lightDir))), 0.0f);
-		
 		const Sphere& sphere = m_ActiveScene->spheres[payload.objectIndex];
-		const Material& material = m_ActiveScene->materials[sphere.materialIndex];
-		auto sphereColor = Utils::Scale(Utils::ToFloat3(material.Albedo), f);
-		color = Utils::Add(color, Utils::Scale(sphereColor, multiplier));
+		Material material = m_ActiveScene->materials[sphere.materialIndex];
+		const DirectX::XMFLOAT3 wo = Utils::Negate(ray.direction);
+		const uint32_t dimension = primaryDimensions + (uint32_t)i * dimensionsPerBounce;
+
+		// SampleLights at the previous surface could have found this emitter too.
+		if (material.IsEmissive() && Utils::Dot(wo, payload.WorldNormal) > 0.0f) {
+			const float weight = i > 0 ? PowerHeuristic(bsdfPdf, LightPdf(ray.origin, previousNormal, (uint32_t)payload.objectIndex)) : 1.0f;
+			color = Utils::Add(color, Utils::Multiply(Utils::Scale(material.Emission, weight), throughput));
+		}
+
+		DirectX::XMFLOAT3 direct = primaryLight;
+		if (i > 0) {
+			material.Roughness = std::max(material.Roughness, m_Settings.glossyFilter);
+			direct = DirectLight(payload, material, wo, nRays, counters, cost ? &sphereTests : nullptr);
+		}
+		if (m_Settings.sampleLights && !m_LightBVH.Empty()) {
+			const DirectX::XMFLOAT3 emitted = SampleLights(payload, material, wo, m_Sampler->Get3D(pixel, sampleIndex, dimension + 4), nRays, counters, cost ? &sphereTests : nullptr);
+			direct = Utils::Add(direct, emitted);
+		}
+		if (m_Settings.sampleLights && m_Environment) {
+			const DirectX::XMFLOAT3 environment = SampleEnvironment(payload, material, wo, m_Sampler->Get2D(pixel, sampleIndex, dimension + 8), nRays, counters, cost ? &sphereTests : nullptr);
+			direct = Utils::Add(direct, environment);
+		}
+		color = Utils::Add(color, Utils::Multiply(direct, throughput));
+
+		if (i + 1 == maxDepth) {
+			break;
+		}
+		Bsdf::Sample sample;
+		if (!Bsdf::SampleDirection(material, payload.WorldNormal, wo, m_Sampler->Get3D(pixel, sampleIndex, dimension), sample)) {
+			break;
+		}
+		throughput = Utils::Multiply(throughput, sample.weight);
+		bsdfPdf = sample.pdf;
+		previousNormal = payload.WorldNormal;
 
-		multiplier *= 0.5f;
+		// A path that survives with probability p carries 1/p of its throughput, so
+		// the estimate stays unbiased while low-throughput paths mostly stop early.
+		if (m_Settings.russianRoulette && i + 1 >= m_Settings.rouletteDepth) {
+			const float survival = std::min(std::max({ throughput.x, throughput.y, throughput.z }), maxSurvival);
+			if (m_Sampler->Get1D(pixel, sampleIndex, dimension + 3) >= survival) {
+				RENDER_STAT(++counters.rouletteTerminations);
+				break;
+			}
+			throughput = Utils::Scale(throughput, 1.0f / survival);
+		}
 
 		ray.origin = Utils::Add(payload.WorldPosition, Utils::Scale(payload.WorldNormal, 0.0001f));
-		ray.direction = Utils::Reflect(ray.direction, 
-			Utils::Add(payload.WorldNormal, Utils::Scale(Utils::RandomFloat3(-0.5f, 0.5f), material.Roughness)));
+		ray.direction = sample.direction;
 	}
 
+	RENDER_STAT(++counters.pathLengths[std::min(surfaces, RenderCounters::maxPathLength)]);
+	RENDER_STAT(counters.surfaceHits += surfaces);
+	if (cost) {
+		cost->sphereTests += (float)sphereTests;
+		cost->bounces += (float)bounces;
+	}
 	return Utils::ToFloat4(color, 1.0f);
 }
 
-Renderer::HitPayload Renderer::TraceRay(const Ray& ray) const
+DirectX::XMFLOAT3 Renderer::DirectLight(const HitPayload& payload, const Material& material, const DirectX::XMFLOAT3& wo, uint32_t& nRays, RenderCounters& counters, uint32_t* sphereTests) const
 {
-	int closestSphere = -1;
-	float hitDistance = std::numeric_limits<float>::max();
+	// The directional light stands in for the sun of the constant sky; a map has its own.
+	if (m_Environment) {
+		return { 0.0f, 0.0f, 0.0f };
+	}
+	const DirectX::XMFLOAT3 toLight = Utils::Normalize(Utils::Negate(lightDir));
+	const DirectX::XMFLOAT3 reflected = Bsdf::Evaluate(material, payload.WorldNormal, wo, toLight);
+	if (Utils::IsZero(reflected)) {
+		return reflected;
+	}
+	// The light is directional, so anything along the shadow ray blocks it.
+	if (m_Settings.shadows) {
+		++nRays;
+		const Ray shadowRay = { Utils::Add(payload.WorldPosition, Utils::Scale(payload.WorldNormal, 0.0001f)), toLight };
+		if (Occluded(shadowRay, std::numeric_limits<float>::max(), counters, sphereTests)) {
+			return { 0.0f, 0.0f, 0.0f };
+		}
+	}
+	return Utils::Scale(reflected, lightIrradiance);
+}
 
-	for (size_t i = 0; i < m_ActiveScene->spheres.size(); ++i) {
-		const Sphere& sphere = m_ActiveScene->spheres[i];
+DirectX::XMFLOAT3 Renderer::SampleLights(const HitPayload& payload, const Material& material, const DirectX::XMFLOAT3& wo, const DirectX::XMFLOAT3& u, uint32_t& nRays, RenderCounters& counters, uint32_t* sphereTests) const
+{
+	const DirectX::XMFLOAT3 origin = Utils::Add(payload.WorldPosition, Utils::Scale(payload.WorldNormal, 0.0001f));
+	uint32_t light;
+	float lightProbability;
+	if (m_Settings.lightTree) {
+		light = m_LightBVH.Sample(origin, payload.WorldNormal, u.z, lightProbability);
+		if (light == UINT32_MAX) {
+			return { 0.0f, 0.0f, 0.0f };
+		}
+	}
+	else {
+		const std::vector<uint32_t>& lights = m_LightBVH.GetLights();
+		light = lights[std::min((size_t)(u.z * (float)lights.size()), lights.size() - 1)];
+		lightProbability = 1.0f / (float)lights.size();
+	}
+	const Sphere& sphere = m_ActiveScene->spheres[light];
+	const float radius = std::abs(sphere.radius);
 
-		DirectX::XMFLOAT3 origin = Utils::Subtract(ray.origin, sphere.position);
+	// Directions are uniform within the cone the sphere subtends, so every one of them hits it.
+	const DirectX::XMFLOAT3 toCenter = Utils::Subtract(sphere.position, origin);
+	const float distanceSq = Utils::Dot(toCenter, toCenter);
+	const float oneMinusCosMax = ConeOneMinusCos(radius, distanceSq);
+	if (oneMinusCosMax <= 0.0f) {
+		return { 0.0f, 0.0f, 0.0f };
+	}
+	const float oneMinusCos = u.x * oneMinusCosMax;
+	const float cosTheta = 1.0f - oneMinusCos;
+	const float sinTheta = sqrtf(std::max(oneMinusCos * (2.0f - oneMinusCos), 0.0f));
+	const float phi = 2.0f * DirectX::XM_PI * u.y;
+	const DirectX::XMFLOAT3 axis = Utils::Scale(toCenter, 1.0f / sqrtf(distanceSq));
+	DirectX::XMFLOAT3 tangent, bitangent;
+	Utils::OrthonormalBasis(axis, tangent, bitangent);
+	const DirectX::XMFLOAT3 wi = Utils::Add(
+		Utils::Add(Utils::Scale(tangent, sinTheta * cosf(phi)), Utils::Scale(bitangent, sinTheta * sinf(phi))),
+		Utils::Scale(axis, cosTheta));
 
-		float a = Utils::Dot(ray.direction, ray.direction);
-		float b = 2.0f * Utils::Dot(origin, ray.direction);
-		float c = Utils::Dot(origin, origin) - sphere.radius * sphere.radius;
+	const DirectX::XMFLOAT3 reflected = Bsdf::Evaluate(material, payload.WorldNormal, wo, wi);
+	if (Utils::IsZero(reflected)) {
+		return reflected;
+	}
+	if (m_Settings.shadows) {
+		// Up to the near side of the emitter, which must not block itself.
+		const float along = Utils::Dot(toCenter, wi);
+		const float distance = along - sqrtf(std::max(radius * radius - (distanceSq - along * along), 0.0f));
+		++nRays;
+		if (Occluded({ origin, wi }, distance * 0.999f, counters, sphereTests)) {
+			return { 0.0f, 0.0f, 0.0f };
+		}
+	}
 
-		float D = b * b - 4.0f * a * c;
+	const float lightPdf = lightProbability / (2.0f * DirectX::XM_PI * oneMinusCosMax);
+	const float weight = PowerHeuristic(lightPdf, Bsdf::Pdf(material, payload.WorldNormal, wo, wi));
+	const Material& emitter = m_ActiveScene->materials[sphere.materialIndex];
+	return Utils::Multiply(reflected, Utils::Scale(emitter.Emission, weight / lightPdf));
+}
 
-		if (D < 0.0f) {
-			continue;
+DirectX::XMFLOAT3 Renderer::SampleEnvironment(const HitPayload& payload, const Material& material, const DirectX::XMFLOAT3& wo, const DirectX::XMFLOAT2& u, uint32_t& nRays, RenderCounters& counters, uint32_t* sphereTests) const
+{
+	DirectX::XMFLOAT3 wi;
+	float environmentPdf;
+	if (!m_Environment->Sample(u, wi, environmentPdf)) {
+		return { 0.0f, 0.0f, 0.0f };
+	}
+	const DirectX::XMFLOAT3 reflected = Bsdf::Evaluate(material, payload.WorldNormal, wo, wi);
+	if (Utils::IsZero(reflected)) {
+		return reflected;
+	}
+	if (m_Settings.shadows) {
+		++nRays;
+		const Ray shadowRay = { Utils::Add(payload.WorldPosition, Utils::Scale(payload.WorldNormal, 0.0001f)), wi };
+		if (Occluded(shadowRay, std::numeric_limits<float>::max(), counters, sphereTests)) {
+			return { 0.0f, 0.0f, 0.0f };
 		}
+	}
+	const float weight = PowerHeuristic(environmentPdf, Bsdf::Pdf(material, payload.WorldNormal, wo, wi));
+	return Utils::Multiply(reflected, Utils::Scale(m_Environment->Lookup(wi), weight / environmentPdf));
+}
 
-		const float closestHit = (-b - sqrt(D)) / (2.0f * a);
-		if (closestHit >= 0.0f && closestHit < hitDistance) {
-			hitDistance = closestHit;
-			closestSphere = (int)i;
+float Renderer::LightPdf(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& normal, uint32_t sphereIndex) const
+{
+	if (!m_Settings.sampleLights || m_LightBVH.Empty()) {
+		return 0.0f;
+	}
+	const Sphere& sphere = m_ActiveScene->spheres[sphereIndex];
+	const DirectX::XMFLOAT3 toCenter = Utils::Subtract(sphere.position, origin);
+	const float oneMinusCosMax = ConeOneMinusCos(std::abs(sphere.radius), Utils::Dot(toCenter, toCenter));
+	if (oneMinusCosMax <= 0.0f) {
+		return 0.0f;
+	}
+	const float lightProbability = m_Settings.lightTree ? m_LightBVH.Probability(origin, normal, sphereIndex) : 1.0f / (float)m_LightBVH.GetLights().size();
+	return lightProbability / (2.0f * DirectX::XM_PI * oneMinusCosMax);
+}
+
+Renderer::HitPayload Renderer::LoadPrimaryHit(size_t pixel, const Ray& primaryRay) const
+{
+	const float hitDistance = m_DepthData[pixel];
+	if (hitDistance < 0.0f) {
+		return Miss();
+	}
+	HitPayload payload;
+	payload.hitDistance = hitDistance;
+	payload.objectIndex = m_PrimaryObjectData[pixel];
+	payload.WorldPosition = Utils::Add(primaryRay.origin, Utils::Scale(primaryRay.direction, hitDistance));
+	payload.WorldNormal = m_NormalData[pixel];
+	return payload;
+}
+
+Renderer::HitPayload Renderer::TraceRay(const Ray& ray, [[maybe_unused]] RenderCounters& counters, uint32_t* sphereTests) const
+{
+	int closestSphere = -1;
+	float hitDistance = std::numeric_limits<float>::max();
+
+	if (m_Settings.useBVH) {
+		BVH::TraversalStats traversal;
+		const bool countTraversal = sphereTests != nullptr || renderCountersEnabled;
+		closestSphere = m_BVH.Intersect(ray, hitDistance, countTraversal ? &traversal : nullptr);
+		RENDER_STAT(counters.nodesVisited += traversal.nodesVisited);
+		RENDER_STAT(counters.sphereTests += traversal.spheresTested);
+		if (sphereTests) {
+			*sphereTests += (uint32_t)traversal.spheresTested;
+		}
+	}
+	else {
+		closestSphere = m_Spheres.Intersect(ray, hitDistance);
+		RENDER_STAT(counters.sphereTests += m_GeometrySphereCount);
+		if (sphereTests) {
+			*sphereTests += (uint32_t)m_GeometrySphereCount;
 		}
 	}
 
@@ -166,6 +1108,28 @@ Renderer::HitPayload Renderer::TraceRay(const Ray& ray) const
 	return ClosestHit(ray, hitDistance, closestSphere);
 }
 
+bool Renderer::Occluded(const Ray& ray, float tMax, [[maybe_unused]] RenderCounters& counters, uint32_t* sphereTests) const
+{
+	RENDER_STAT(++counters.shadowRays);
+	if (m_Settings.useBVH) {
+		BVH::TraversalStats traversal;
+		const bool countTraversal = sphereTests != nullptr || renderCountersEnabled;
+		const bool occluded = m_BVH.Occluded(ray, tMax, countTraversal ? &traversal : nullptr);
+		RENDER_STAT(counters.nodesVisited += traversal.nodesVisited);
+		RENDER_STAT(counters.sphereTests += traversal.spheresTested);
+		if (sphereTests) {
+			*sphereTests += (uint32_t)traversal.spheresTested;
+		}
+		return occluded;
+	}
+	// The flat kernel stops early too, so this counts an upper bound.
+	RENDER_STAT(counters.sphereTests += m_GeometrySphereCount);
+	if (sphereTests) {
+		*sphereTests += (uint32_t)m_GeometrySphereCount;
+	}
+	return m_Spheres.Occluded(ray, tMax);
+}
+
 Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, float hitDistance, int objectIndex) const
 {
 	HitPayload payload;
@@ -1,10 +1,19 @@
 #pragma once
 
-#include "Graphics.h"
+#include "Framebuffer.h"
 #include "Ray.h"
 #include "Camera.h"
 #include "Scene.h"
+#include "BVH.h"
+#include "LightBVH.h"
+#include "EnvironmentMap.h"
+#include "SphereSoA.h"
+#include "RayPacket.h"
+#include "ThreadPool.h"
+#include "Sampler.h"
+#include "RenderStats.h"
 #include <DirectXMath.h>
+#include <atomic>
 
 class Renderer {
 private:
@@ -15,13 +24,124 @@ private:
 		int objectIndex;
 	};
 public:
-	Renderer(Graphics& gfx);
-	void Render(Graphics& gfx, const Scene& scene, const Camera& camera);
+	enum class DisplayMode {
+		Color,
+		Noise,
+		SampleCount,
+		// Per-pixel cost heat maps, mean per sample
+		IntersectionTests,
+		Bounces,
+		Time,
+	};
+	// The knobs RenderUI exposes, so drivers without a UI can set them too.
+	struct Settings {
+		bool accumulate = true;
+		bool antiAliasing = false;
+		Sampler::Type sampler = Sampler::Type::Sobol;
+		DisplayMode displayMode = DisplayMode::Color;
+		// Collects per-pixel cost even when not displayed, for ResolveCost. The cost
+		// display modes collect regardless. Primary rays are then traced one at a
+		// time, so each pixel's cost is its own.
+		bool collectCost = false;
+		// Adaptive sampling, scheduled per 8x8 block
+		bool adaptive = true;
+		float targetNoise = 0.01f; // relative standard error of a pixel's mean luminance
+		int minSamples = 16;
+		int maxSamplesPerFrame = 8;
+		// Progressive resolution: after a reset, trace every stride-th pixel and refine
+		bool reduceResolution = true;
+		float motionBudget = 33.0f; // ms per frame while accumulation keeps being reset
+		// Temporal reprojection: camera moves carry accumulated samples into the new view
+		bool reproject = true;
+		int historyLimit = 32; // samples a pixel keeps when carried to a new view
+		// Scene edits reset only the blocks the edited objects cover on screen, before
+		// and after the edit. The rest keep at most editHistoryLimit samples, so
+		// reflections of the edit, which screen bounds miss, still catch up.
+		bool localEditReset = true;
+		int editHistoryLimit = 64;
+		// Direct light is tested for visibility with a shadow ray
+		bool shadows = true;
+		// Every surface samples a direction towards one emissive sphere and one from
+		// the environment map. BSDF samples that hit an emitter or escape to the
+		// environment are weighted against them by multiple importance sampling.
+		bool sampleLights = true;
+		// Emitters are picked by their estimated contribution from a LightBVH; off, uniformly.
+		bool lightTree = true;
+		// Lowest roughness past the first surface. Glints of the directional light
+		// on near-mirrors, seen through a diffuse bounce, can be fireflies for
+		// hundreds of frames; above 0 this trades them for a little blur and bias.
+		float glossyFilter = 0.0f;
+		// Path depth: at most maxDepth surfaces per path. Past rouletteDepth surfaces,
+		// Russian roulette ends paths in proportion to their remaining throughput.
+		int maxDepth = 5;
+		bool russianRoulette = true;
+		int rouletteDepth = 2;
+		// Scheduling
+		int threadCount = 0; // 0 = one per hardware thread
+		uint32_t tileSize = 32; // multiple of RayPacket::tileSize
+		// Acceleration structure
+		bool useBVH = true;
+		bool usePackets = true;
+	};
+public:
+	Renderer(int width, int height);
+	void Resize(int width, int height);
+	void Render(Framebuffer& framebuffer, const Scene& scene, const Camera& camera);
 	void RenderUI();
+	const DirectX::XMFLOAT4& GetClearColor() const noexcept;
+	Settings& GetSettings() noexcept;
+	const Settings& GetSettings() const noexcept;
+	float GetLastRenderTime() const noexcept;
+	uint64_t GetLastRayCount() const noexcept; // primary, secondary and shadow rays traced by the last Render
+	const RenderStats& GetLastFrameStats() const noexcept;
+	uint32_t GetThreadCount() const noexcept;
 	void ResetFrameIndex();
+	void OnCameraMoved();
+	// Writes the unclamped mean radiance of every pixel, for HDR output.
+	void ResolveRadiance(Framebuffer& framebuffer) const;
+	// Writes the mean cost per sample: sphere tests, bounces and nanoseconds in
+	// red, green and blue. Zero where no cost was collected.
+	void ResolveCost(Framebuffer& framebuffer) const;
 private:
-	DirectX::XMFLOAT4 PerPixel(uint64_t x, uint64_t y); // RayGen
-	HitPayload TraceRay(const Ray& ray) const;
+	struct PixelCost {
+		float sphereTests = 0.0f;
+		float bounces = 0.0f; // surfaces hit
+		float time = 0.0f; // ns
+		float samples = 0.0f;
+	};
+private:
+	void RenderTile(Framebuffer& framebuffer, uint32_t tileX, uint32_t tileY, uint32_t worker);
+	void RenderBlock(Framebuffer& framebuffer, uint64_t x0, uint64_t y0, uint32_t stride, RenderCounters& counters);
+	static bool IsCostDisplay(DisplayMode mode) noexcept;
+	static float MeanCost(const PixelCost& cost, DisplayMode mode) noexcept;
+	// Resets accumulation where an edit shows on screen; false when it has to be the whole frame.
+	bool ResetEditedBlocks(const Scene& scene, const SceneChanges& changes, const Camera& camera);
+	bool MarkScreenBounds(const DirectX::XMFLOAT3& center, float radius, DirectX::FXMMATRIX viewProjection, std::vector<uint8_t>& blocks) const;
+	uint32_t ChooseMotionStride() const;
+	void ScheduleSamples();
+	float PixelError(size_t pixel) const;
+	DirectX::XMFLOAT4 ResolvePixel(size_t pixel) const;
+	void GeneratePrimaryRays(uint64_t x0, uint64_t y0, uint32_t stride, RayPacket& packet) const;
+	// With costs, rays are traced one by one and each lane's sphere tests and time are recorded.
+	void TracePrimaryRays(uint64_t x0, uint64_t y0, uint32_t stride, RayPacket& packet, HitPayload* hits, RenderCounters& counters, PixelCost* costs) const;
+	bool ReprojectPixel(uint64_t x, uint64_t y, const HitPayload& primaryHit);
+	DirectX::XMFLOAT4 PerPixel(uint64_t x, uint64_t y, uint32_t sampleIndex, const Ray& primaryRay, const HitPayload& primaryHit, const DirectX::XMFLOAT3& primaryLight, uint32_t& nRays, RenderCounters& counters, PixelCost* cost); // RayGen
+	// Light reflected towards wo from the directional light, which an environment map replaces.
+	DirectX::XMFLOAT3 DirectLight(const HitPayload& payload, const Material& material, const DirectX::XMFLOAT3& wo, uint32_t& nRays, RenderCounters& counters, uint32_t* sphereTests = nullptr) const;
+	// Light reflected towards wo from one emissive sphere, MIS-weighted against
+	// BSDF samples. u picks the direction within the sphere's cone (x, y) and the sphere (z).
+	DirectX::XMFLOAT3 SampleLights(const HitPayload& payload, const Material& material, const DirectX::XMFLOAT3& wo, const DirectX::XMFLOAT3& u, uint32_t& nRays, RenderCounters& counters, uint32_t* sphereTests = nullptr) const;
+	// Light reflected towards wo from one direction of the environment map, MIS-weighted against BSDF samples.
+	DirectX::XMFLOAT3 SampleEnvironment(const HitPayload& payload, const Material& material, const DirectX::XMFLOAT3& wo, const DirectX::XMFLOAT2& u, uint32_t& nRays, RenderCounters& counters, uint32_t* sphereTests = nullptr) const;
+	// Solid-angle density of SampleLights choosing a direction towards the emissive
+	// sphere from origin, on a surface with the given normal.
+	float LightPdf(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& normal, uint32_t sphereIndex) const;
+	// Whether an edit adds, removes or changes an emitter, as m_LightBVH knows them.
+	bool EditsLights(const Scene& scene, const SceneChanges& changes) const;
+	HitPayload LoadPrimaryHit(size_t pixel, const Ray& primaryRay) const;
+	HitPayload TraceRay(const Ray& ray, RenderCounters& counters, uint32_t* sphereTests = nullptr) const;
+	// Any-hit query for shadow rays: no hit point, normal or closest sphere.
+	bool Occluded(const Ray& ray, float tMax, RenderCounters& counters, uint32_t* sphereTests = nullptr) const;
 	HitPayload ClosestHit(const Ray& ray, float hitDistance, int objectIndex) const;
 	HitPayload Miss() const;
 private:
@@ -30,12 +150,85 @@ private:
 	int m_Width = 0;
 	int m_Height = 0;
 	float lastRenderTime = 0.0f;
-	bool m_Accumulate = true;
 	uint64_t m_FrameIndex = 1u;
-	std::unique_ptr<DirectX::XMFLOAT4[]> m_AccumulationData = nullptr;
-	std::vector<uint64_t> m_VerticalIter;
-	std::vector<uint64_t> m_HorizontalIter;
+	Settings m_Settings;
+	std::unique_ptr<DirectX::XMFLOAT4[]> m_AccumulationData = nullptr; // w holds the sample count
+	std::unique_ptr<float[]> m_LuminanceSquaredData = nullptr; // sum of squared sample luminance
+	// Next sampler index per pixel. Unlike the accumulated weight it is only
+	// rewound by a full reset, so clamped or reprojected history never makes a
+	// pixel redraw sample points it has already averaged in.
+	std::unique_ptr<uint32_t[]> m_SampleIndexData = nullptr;
+	// Adaptive sampling, scheduled per 8x8 block
+	std::vector<float> m_BlockErrors; // worst pixel error in units of the target noise, last frame
+	std::vector<uint32_t> m_BlockSamples; // samples per pixel this frame, 0 once converged
+	uint32_t m_ActiveBlocks = 0;
+	// Progressive resolution: after a reset, trace every stride-th pixel and refine
+	uint32_t m_Stride = 1; // 1, 2 or 4 pixels between traced pixels this frame
+	float m_TimePerPixel = 0.0f; // ms per traced pixel, measured on reset frames
+	// Cost heat maps
+	bool m_CollectCost = false;
+	std::unique_ptr<PixelCost[]> m_CostData = nullptr; // sums over the pixel's samples
+	float m_CostRange = 1.0f; // largest mean cost of the displayed kind, last frame
+	// Temporal reprojection: camera moves carry accumulated samples into the new view
+	static constexpr float reprojectionDepthTolerance = 0.02f; // relative first-hit distance
+	static constexpr float reprojectionNormalTolerance = 0.9f; // minimum cosine between normals
+	bool m_CameraMoved = false;
+	bool m_ReprojectThisFrame = false;
+	std::atomic<uint32_t> m_ReprojectedPixels = 0;
+	std::unique_ptr<float[]> m_DepthData = nullptr; // first-hit distance, negative on a miss
+	std::unique_ptr<DirectX::XMFLOAT3[]> m_NormalData = nullptr; // first-hit normal
+	std::unique_ptr<DirectX::XMFLOAT4[]> m_HistoryAccumulationData = nullptr;
+	std::unique_ptr<float[]> m_HistoryLuminanceSquaredData = nullptr;
+	std::unique_ptr<float[]> m_HistoryDepthData = nullptr;
+	std::unique_ptr<DirectX::XMFLOAT3[]> m_HistoryNormalData = nullptr;
+	DirectX::XMFLOAT4X4 m_PreviousViewProjection = {};
+	DirectX::XMFLOAT3 m_PreviousPosition = { 0.0f, 0.0f, 0.0f };
+	// Primary-hit cache: without jitter a static camera hits the same points every
+	// frame, so the first hit is rebuilt from m_DepthData, m_NormalData and these.
+	bool m_PrimaryCacheValid = false; // read this frame instead of tracing primary rays
+	bool m_FillPrimaryCache = false; // written this frame, valid from the next
+	std::unique_ptr<int32_t[]> m_PrimaryObjectData = nullptr; // first-hit sphere
+	std::unique_ptr<DirectX::XMFLOAT3[]> m_PrimaryLightData = nullptr; // first-hit direct light
+	DirectX::XMFLOAT3 m_PrimaryLightDir = { 0.0f, 0.0f, 0.0f }; // lightDir the cache was filled with
+	// Sampling
+	static constexpr uint32_t primaryDimensions = 2; // sub-pixel jitter
+	// BSDF direction and lobe, Russian roulette, direction to and choice of an
+	// emitter, one unused so the pairs below and each bounce start on a Sobol
+	// pair, and the environment direction. 2D samples sit on even offsets.
+	static constexpr uint32_t dimensionsPerBounce = 10;
+	static constexpr float maxSurvival = 0.95f; // roulette never keeps a path for certain
+	Sampler::Type m_SamplerType = Sampler::Type::Sobol; // type of m_Sampler
+	std::unique_ptr<Sampler> m_Sampler;
+	// Scheduling
+	ThreadPool m_ThreadPool;
+	std::vector<float> m_TileTimes; // ms, row-major tiles of the last frame
+	std::atomic<uint64_t> m_RayCount = 0;
+	// Each worker writes only its own slot; a cache line apiece keeps them from false sharing.
+	struct alignas(64) WorkerStats {
+		RenderCounters counters;
+		float busyTime = 0.0f; // ms
+		uint32_t tiles = 0;
+	};
+	std::vector<WorkerStats> m_WorkerStats;
+	RenderStats m_FrameStats;
+	int m_TraceSaved = 0; // result of the last "Save trace" in RenderUI: 1 ok, -1 failed
+	// Acceleration structure
+	BVH m_BVH;
+	SphereSoA m_Spheres;
+	LightBVH m_LightBVH; // emissive spheres
+	std::shared_ptr<const EnvironmentMap> m_Environment; // the scene's, as accumulated so far
+	// Edits refit the BVH until it is this much costlier than freshly built.
+	static constexpr float maxRefitCost = 1.5f;
+	bool m_GeometryDirty = true;
+	size_t m_GeometrySphereCount = 0;
+	// Scene versioning: what the buffers and caches were last brought up to date with
+	uint64_t m_SceneId = 0;
+	uint64_t m_SceneVersion = 0;
+	size_t m_SceneMaterialCount = 0;
+	static constexpr float maxEditResetCoverage = 0.5f; // beyond this share of blocks an edit resets everything
+	float m_EditResetCoverage = 0.0f; // share of blocks the last edit reset
 	// Scene
 	DirectX::XMFLOAT4 clearColor = { 0.6f, 0.8f, 0.9f, 1.0f };
 	DirectX::XMFLOAT3 lightDir = { -1.0f, 1.0f, 1.0f };
+	static constexpr float lightIrradiance = DirectX::XM_PI; // a white diffuse surface facing the light reflects 1
 };
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "Renderer.h"
+#include "Profiler.h"
+#include "imgui.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <iterator>
+#include <string>
+
+// Kept out of Renderer.cpp so raytracer_core does not depend on ImGui.
+void Renderer::RenderUI()
+{
+	ImGui::Begin("Settings");
+
+	ImGui::Text("Last render: %.3fms", lastRenderTime);
+	if (ImGui::SliderFloat3("Light direction", &lightDir.x, -1.0f, 1.0f)) {
+		ResetFrameIndex();
+	}
+	ImGui::Text("Primary-hit cache: %s", m_PrimaryCacheValid ? "in use" : m_Settings.antiAliasing ? "off (anti-aliasing)" : "filling");
+
+	ImGui::Separator();
+
+	ImGui::Checkbox("Accumulate", &m_Settings.accumulate);
+	if (ImGui::BeginCombo("Sampler", Sampler::GetName(m_Settings.sampler))) {
+		for (Sampler::Type type : { Sampler::Type::Independent, Sampler::Type::Sobol, Sampler::Type::Halton, Sampler::Type::BlueNoise }) {
+			if (ImGui::Selectable(Sampler::GetName(type), type == m_Settings.sampler)) {
+				m_Settings.sampler = type;
+			}
+		}
+		ImGui::EndCombo();
+	}
+	if (ImGui::Checkbox("Anti-aliasing", &m_Settings.antiAliasing)) {
+		ResetFrameIndex();
+	}
+	if (ImGui::Button("Reset")) {
+		ResetFrameIndex();
+	}
+	ImGui::Checkbox("Adaptive sampling", &m_Settings.adaptive);
+	if (m_Settings.adaptive) {
+		ImGui::SliderFloat("Target noise", &m_Settings.targetNoise, 0.001f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic);
+		ImGui::SliderInt("Min samples", &m_Settings.minSamples, 2, 256);
+		ImGui::SliderInt("Max samples/frame", &m_Settings.maxSamplesPerFrame, 1, 64);
+		if (m_ActiveBlocks == 0) {
+			ImGui::Text("Converged after %llu frames", (unsigned long long)(m_FrameIndex - 1));
+		}
+		else {
+			ImGui::Text("Active blocks: %u/%zu", m_ActiveBlocks, m_BlockSamples.size());
+		}
+	}
+	if (ImGui::Checkbox("Shadows", &m_Settings.shadows)) {
+		ResetFrameIndex();
+	}
+	if (ImGui::Checkbox("Sample emitters", &m_Settings.sampleLights)) {
+		ResetFrameIndex();
+	}
+	ImGui::SameLine();
+	ImGui::Text("(%zu emissive spheres)", m_LightBVH.GetLights().size());
+	if (m_Settings.sampleLights && ImGui::Checkbox("Light tree", &m_Settings.lightTree)) {
+		ResetFrameIndex();
+	}
+	if (m_Environment) {
+		const EnvironmentMap::LoadStats& environmentStats = m_Environment->GetLoadStats();
+		ImGui::Text("Environment: %ux%u, loaded in %.1f ms%s", m_Environment->GetWidth(), m_Environment->GetHeight(),
+			environmentStats.loadTime, environmentStats.tablesCached ? " (cached tables)" : "");
+	}
+	if (ImGui::SliderInt("Max depth", &m_Settings.maxDepth, 1, 16)) {
+		ResetFrameIndex();
+	}
+	if (ImGui::SliderFloat("Glossy filter", &m_Settings.glossyFilter, 0.0f, 1.0f, "%.2f")) {
+		ResetFrameIndex();
+	}
+	ImGui::Checkbox("Russian roulette", &m_Settings.russianRoulette);
+	if (m_Settings.russianRoulette) {
+		ImGui::SliderInt("Roulette after", &m_Settings.rouletteDepth, 1, 16);
+	}
+	ImGui::Checkbox("Reduce resolution while moving", &m_Settings.reduceResolution);
+	if (m_Settings.reduceResolution) {
+		ImGui::SliderFloat("Motion budget (ms)", &m_Settings.motionBudget, 5.0f, 100.0f, "%.1f");
+		ImGui::Text("Traced pixels: 1/%u", m_Stride * m_Stride);
+	}
+	ImGui::Checkbox("Reproject on camera motion", &m_Settings.reproject);
+	if (m_Settings.reproject) {
+		ImGui::SliderInt("History limit", &m_Settings.historyLimit, 1, 1024);
+		ImGui::Text("Reprojected: %.1f%%", 100.0f * (float)m_ReprojectedPixels.load(std::memory_order_relaxed) / ((float)m_Width * (float)m_Height));
+	}
+	ImGui::Checkbox("Reset only edited regions", &m_Settings.localEditReset);
+	if (m_Settings.localEditReset) {
+		ImGui::SliderInt("Edit history limit", &m_Settings.editHistoryLimit, 1, 1024);
+		ImGui::Text("Last edit reset: %.1f%% of blocks", 100.0f * m_EditResetCoverage);
+	}
+	const char* displayModes[] = { "Color", "Noise", "Sample count", "Sphere tests", "Bounces", "Time" };
+	int displayMode = (int)m_Settings.displayMode;
+	if (ImGui::Combo("Display", &displayMode, displayModes, (int)std::size(displayModes))) {
+		m_Settings.displayMode = (DisplayMode)displayMode;
+	}
+	if (IsCostDisplay(m_Settings.displayMode)) {
+		const char* units = m_Settings.displayMode == DisplayMode::Time ? "ns" : m_Settings.displayMode == DisplayMode::Bounces ? "bounces" : "tests";
+		ImGui::Text("Heat map max: %.1f %s per sample (log scale)", m_CostRange, units);
+	}
+
+	ImGui::Separator();
+
+	ImGui::SliderInt("Threads", &m_Settings.threadCount, 1, (int)ThreadPool::HardwareThreadCount());
+	if (ImGui::BeginCombo("Tile size", std::to_string(m_Settings.tileSize).c_str())) {
+		for (uint32_t size : { 8u, 16u, 32u, 64u }) {
+			if (ImGui::Selectable(std::to_string(size).c_str(), size == m_Settings.tileSize)) {
+				m_Settings.tileSize = size;
+			}
+		}
+		ImGui::EndCombo();
+	}
+	if (!m_TileTimes.empty()) {
+		const auto [minTime, maxTime] = std::ranges::minmax(m_TileTimes);
+		float totalTime = 0.0f;
+		for (float time : m_TileTimes) {
+			totalTime += time;
+		}
+		ImGui::Text("Tiles: %zu, stolen: %u", m_TileTimes.size(), m_ThreadPool.GetLastStealCount());
+		ImGui::Text("Tile time min/avg/max: %.3f/%.3f/%.3fms", minTime, totalTime / m_TileTimes.size(), maxTime);
+	}
+
+	if (ImGui::CollapsingHeader("Frame stats")) {
+		const RenderStats& stats = m_FrameStats;
+		const RenderCounters& counters = stats.counters;
+		if (stats.countersEnabled) {
+			const uint64_t rays = counters.primaryRays + counters.secondaryRays + counters.shadowRays;
+			const uint64_t hitRays = counters.primaryRays + counters.secondaryRays;
+			ImGui::Text("Rays: %llu primary, %llu secondary, %llu shadow, %.1f%% missed", (unsigned long long)counters.primaryRays,
+				(unsigned long long)counters.secondaryRays, (unsigned long long)counters.shadowRays, hitRays > 0 ? 100.0 * counters.misses / hitRays : 0.0);
+			ImGui::Text("Per ray: %.1f nodes, %.1f sphere tests", rays > 0 ? (double)counters.nodesVisited / rays : 0.0,
+				rays > 0 ? (double)counters.sphereTests / rays : 0.0);
+			ImGui::Text("%.2f Mrays/s", stats.frameTime > 0.0f ? rays / stats.frameTime / 1000.0 : 0.0);
+
+			float pathLengths[RenderCounters::maxPathLength + 1];
+			for (uint32_t i = 0; i <= RenderCounters::maxPathLength; ++i) {
+				pathLengths[i] = (float)counters.pathLengths[i];
+			}
+			ImGui::PlotHistogram("Surfaces per path", pathLengths, (int)std::size(pathLengths), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+			ImGui::Text("Mean path length: %.2f, %llu ended by roulette", counters.MeanPathLength(), (unsigned long long)counters.rouletteTerminations);
+		}
+		else {
+			ImGui::TextUnformatted("Counters compiled out (RAYTRACER_STATS)");
+		}
+		for (size_t i = 0; i < stats.workers.size(); ++i) {
+			const RenderStats::Worker& worker = stats.workers[i];
+			ImGui::Text("Worker %zu: busy %.3fms, idle %.3fms, %u tiles", i, worker.busyTime, worker.idleTime, worker.tiles);
+		}
+	}
+	if (ImGui::CollapsingHeader("Timeline")) {
+		bool recording = Profiler::IsRecording();
+		if (ImGui::Checkbox("Record", &recording)) {
+			Profiler::SetRecording(recording);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Clear")) {
+			Profiler::Clear();
+		}
+		ImGui::SameLine();
+		// Between frames no worker is inside a zone, so the buffers can be read here.
+		if (ImGui::Button("Save trace")) {
+			m_TraceSaved = Profiler::WriteChromeTrace("render_trace.json") ? 1 : -1;
+		}
+		if (m_TraceSaved != 0) {
+			ImGui::TextUnformatted(m_TraceSaved > 0 ? "Saved render_trace.json" : "Failed to write render_trace.json");
+		}
+	}
+
+	ImGui::Separator();
+
+	ImGui::Checkbox("Packet primary rays", &m_Settings.usePackets);
+	ImGui::Checkbox("Use BVH", &m_Settings.useBVH);
+	if (m_Settings.useBVH) {
+		const BVH::BuildStats& stats = m_BVH.GetBuildStats();
+		ImGui::Text("BVH build: %.3fms", stats.buildTime);
+		ImGui::Text("Nodes: %u, leaves: %u, depth: %u", stats.nodeCount, stats.leafCount, stats.maxDepth);
+		ImGui::Text("SAH cost: %.2f (%.2f after refits)", stats.sahCost, m_BVH.GetSahCost());
+	}
+
+	ImGui::End();
+}
@@ -0,0 +1,266 @@
+#include "Sampler.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <math.h>
+
+namespace
+{
+	uint32_t ReverseBits(uint32_t x)
+	{
+		x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+		x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+		x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+		x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+		return (x >> 16) | (x << 16);
+	}
+
+	uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed)
+	{
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return x;
+	}
+
+	uint32_t NestedUniformScramble(uint32_t x, uint32_t seed)
+	{
+		return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+	}
+
+	float RadicalInverse(uint32_t base, uint32_t index)
+	{
+		const float invBase = 1.0f / (float)base;
+		float invBaseN = 1.0f;
+		uint32_t reversed = 0;
+		while (index > 0) {
+			const uint32_t next = index / base;
+			reversed = reversed * base + (index - next * base);
+			invBaseN *= invBase;
+			index = next;
+		}
+		return std::min(reversed * invBaseN, 0x1.fffffep-1f);
+	}
+
+	constexpr uint32_t primes[] = {
+		2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+		59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131
+	};
+
+	// Distinct stream tags so samplers never reuse each other's hash outputs.
+	constexpr uint32_t sobolShuffleStream = 0x5b0b5eedu;
+	constexpr uint32_t sobolScrambleStream = 0x5c4a3b1eu;
+	constexpr uint32_t haltonRotationStream = 0x4a170e5u;
+}
+
+DirectX::XMFLOAT2 Sampler::Get2D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+	return { Get1D(pixel, sampleIndex, dimension), Get1D(pixel, sampleIndex, dimension + 1) };
+}
+
+DirectX::XMFLOAT3 Sampler::Get3D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+	return { Get1D(pixel, sampleIndex, dimension), Get1D(pixel, sampleIndex, dimension + 1), Get1D(pixel, sampleIndex, dimension + 2) };
+}
+
+std::unique_ptr<Sampler> Sampler::Create(Type type)
+{
+	switch (type) {
+	case Type::Sobol:
+		return std::make_unique<SobolSampler>();
+	case Type::Halton:
+		return std::make_unique<HaltonSampler>();
+	case Type::BlueNoise:
+		return std::make_unique<BlueNoiseSampler>();
+	case Type::Independent:
+	default:
+		return std::make_unique<IndependentSampler>();
+	}
+}
+
+const char* Sampler::GetName(Type type) noexcept
+{
+	switch (type) {
+	case Type::Sobol:
+		return "Owen-scrambled Sobol";
+	case Type::Halton:
+		return "Halton";
+	case Type::BlueNoise:
+		return "Blue-noise dithered";
+	case Type::Independent:
+	default:
+		return "Independent";
+	}
+}
+
+float IndependentSampler::Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+	return Random::Float(pixel.index, sampleIndex, 0u, dimension);
+}
+
+SobolSampler::SobolSampler()
+{
+	// Sobol dimension 1: direction numbers follow Pascal's triangle mod 2.
+	uint32_t v = 1u << 31;
+	for (uint32_t bit = 0; bit < 32; ++bit) {
+		m_Directions[bit] = v;
+		v ^= v >> 1;
+	}
+}
+
+float SobolSampler::Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+	const uint32_t pair = dimension / 2;
+	const uint32_t seed = Random::UInt(pixel.index, pair, sobolShuffleStream, 0u);
+	const uint32_t index = NestedUniformScramble(sampleIndex, seed);
+
+	// Dimension 0 is the bit-reversed index; dimension 1 XORs one direction per set bit.
+	uint32_t x = 0;
+	if ((dimension & 1) == 0) {
+		x = ReverseBits(index);
+	} else {
+		for (uint32_t bits = index; bits != 0; bits &= bits - 1) {
+			x ^= m_Directions[std::countr_zero(bits)];
+		}
+	}
+
+	x = NestedUniformScramble(x, Random::UInt(pixel.index, dimension, sobolScrambleStream, 0u));
+	return Random::ToFloat(x);
+}
+
+float HaltonSampler::Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+	if (dimension >= std::size(primes)) {
+		return Random::Float(pixel.index, sampleIndex, 0u, dimension);
+	}
+	const float rotation = Random::Float(pixel.index, dimension, haltonRotationStream, 0u);
+	const float value = RadicalInverse(primes[dimension], sampleIndex) + rotation;
+	return value >= 1.0f ? value - 1.0f : value;
+}
+
+BlueNoiseSampler::BlueNoiseSampler()
+{
+	for (uint32_t d = 0; d < std::size(m_Steps); ++d) {
+		const double root = sqrt((double)primes[d]);
+		m_Steps[d] = root - floor(root);
+	}
+
+	// Void-and-cluster (Ulichney 1993) on a torus. A Gaussian energy field over the
+	// set pixels is kept up to date; clusters are removed and voids filled in rank order.
+	constexpr uint32_t size = maskSize;
+	constexpr uint32_t n = size * size;
+	constexpr float sigma = 1.5f;
+
+	std::vector<float> kernel(n);
+	for (uint32_t y = 0; y < size; ++y) {
+		for (uint32_t x = 0; x < size; ++x) {
+			const float dx = (float)std::min(x, size - x);
+			const float dy = (float)std::min(y, size - y);
+			kernel[x + y * size] = expf(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+		}
+	}
+
+	std::vector<uint8_t> pattern(n, 0);
+	std::vector<float> energy(n, 0.0f);
+	auto splat = [&](uint32_t p, float sign) {
+		const uint32_t px = p % size, py = p / size;
+		for (uint32_t y = 0; y < size; ++y) {
+			for (uint32_t x = 0; x < size; ++x) {
+				energy[x + y * size] += sign * kernel[((x - px) & (size - 1)) + ((y - py) & (size - 1)) * size];
+			}
+		}
+	};
+	auto tightestCluster = [&] {
+		uint32_t best = 0;
+		float bestEnergy = -INFINITY;
+		for (uint32_t i = 0; i < n; ++i) {
+			if (pattern[i] && energy[i] > bestEnergy) {
+				bestEnergy = energy[i];
+				best = i;
+			}
+		}
+		return best;
+	};
+	auto largestVoid = [&] {
+		uint32_t best = 0;
+		float bestEnergy = INFINITY;
+		for (uint32_t i = 0; i < n; ++i) {
+			if (!pattern[i] && energy[i] < bestEnergy) {
+				bestEnergy = energy[i];
+				best = i;
+			}
+		}
+		return best;
+	};
+
+	// Initial pattern: 10% random points, relaxed until the tightest cluster is the largest void.
+	const uint32_t nInitial = n / 10;
+	for (uint32_t i = 0, placed = 0; placed < nInitial; ++i) {
+		const uint32_t p = Random::UInt(i, 0u, 0xb1ee0015u, 0u) % n;
+		if (!pattern[p]) {
+			pattern[p] = 1;
+			splat(p, 1.0f);
+			++placed;
+		}
+	}
+	while (true) {
+		const uint32_t cluster = tightestCluster();
+		pattern[cluster] = 0;
+		splat(cluster, -1.0f);
+		const uint32_t hole = largestVoid();
+		pattern[hole] = 1;
+		splat(hole, 1.0f);
+		if (hole == cluster) {
+			break;
+		}
+	}
+
+	std::vector<uint32_t> ranks(n, 0);
+	{
+		std::vector<uint8_t> initialPattern = pattern;
+		std::vector<float> initialEnergy = energy;
+		for (uint32_t rank = nInitial; rank-- > 0;) {
+			const uint32_t cluster = tightestCluster();
+			pattern[cluster] = 0;
+			splat(cluster, -1.0f);
+			ranks[cluster] = rank;
+		}
+		pattern = std::move(initialPattern);
+		energy = std::move(initialEnergy);
+	}
+	for (uint32_t rank = nInitial; rank < n; ++rank) {
+		const uint32_t hole = largestVoid();
+		pattern[hole] = 1;
+		splat(hole, 1.0f);
+		ranks[hole] = rank;
+	}
+
+	m_Mask.resize(n);
+	for (uint32_t i = 0; i < n; ++i) {
+		m_Mask[i] = ((float)ranks[i] + 0.5f) / (float)n;
+	}
+}
+
+float BlueNoiseSampler::Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+	if (dimension >= std::size(m_Steps)) {
+		return Random::Float(pixel.index, sampleIndex, 0u, dimension);
+	}
+	// Each dimension reads the mask at a different toroidal shift so dimensions stay decorrelated.
+	const uint32_t shift = Random::UInt(dimension, 0u, 0xb1ee0015u, 1u);
+	const uint32_t x = (pixel.x + (shift & 0xffffu)) & (maskSize - 1);
+	const uint32_t y = (pixel.y + (shift >> 16)) & (maskSize - 1);
+	const float offset = m_Mask[x + y * maskSize];
+
+	// Additive recurrence with an irrational step per dimension (Richtmyer): well
+	// stratified in 1D for any prefix, and dimensions do not move in lockstep.
+	const double step = m_Steps[dimension];
+	const double position = sampleIndex * step;
+	const float sequence = (float)(position - floor(position));
+	const float value = sequence + offset;
+	return std::min(value >= 1.0f ? value - 1.0f : value, 0x1.fffffep-1f);
+}
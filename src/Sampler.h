@@ -0,0 +1,71 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Supplies the random dimensions consumed by a path. Every call is a pure
+// function of (pixel, sample index, dimension), so samplers are shared by all
+// render threads without locking. Dimensions are allocated by the caller,
+// e.g. ten per bounce in PerPixel: the BSDF sample, Russian roulette, and the
+// emitter and environment samples.
+class Sampler {
+public:
+	enum class Type {
+		Independent,
+		Sobol,
+		Halton,
+		BlueNoise,
+	};
+	struct PixelKey {
+		uint32_t x;
+		uint32_t y;
+		uint32_t index; // x + y * width
+	};
+public:
+	virtual ~Sampler() = default;
+	virtual float Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const = 0;
+	DirectX::XMFLOAT2 Get2D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const;
+	DirectX::XMFLOAT3 Get3D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const;
+	static std::unique_ptr<Sampler> Create(Type type);
+	static const char* GetName(Type type) noexcept;
+};
+
+// Uncorrelated hash-based samples; what PerPixel used before samplers existed.
+class IndependentSampler : public Sampler {
+public:
+	float Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const override;
+};
+
+// Owen-scrambled Sobol (Burley, "Practical Hash-based Owen Scrambling", JCGT 2020).
+// Dimensions are consumed in pairs of the first two Sobol dimensions; each pair
+// gets its own index shuffle and scramble so pairs stay decorrelated.
+class SobolSampler : public Sampler {
+public:
+	SobolSampler();
+	float Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const override;
+private:
+	uint32_t m_Directions[32];
+};
+
+// Halton radical inverses in the first primes, Cranley-Patterson rotated per
+// pixel. Dimensions past the prime table fall back to independent samples.
+class HaltonSampler : public Sampler {
+public:
+	float Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const override;
+};
+
+// Additive recurrence per dimension, offset per pixel by a blue-noise mask, so
+// the remaining error is pushed to high screen-space frequencies. Dimensions past
+// the step table fall back to independent samples.
+class BlueNoiseSampler : public Sampler {
+public:
+	static constexpr uint32_t maskSize = 64;
+public:
+	BlueNoiseSampler();
+	float Get1D(const PixelKey& pixel, uint32_t sampleIndex, uint32_t dimension) const override;
+private:
+	std::vector<float> m_Mask; // maskSize x maskSize ranks in [0, 1)
+	double m_Steps[32]; // fractional part of sqrt(prime) per dimension
+};
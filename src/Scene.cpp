@@ -0,0 +1,101 @@
+#include "Scene.h"
+
+#include <atomic>
+
+namespace
+{
+	std::atomic<uint64_t> nextSceneId = 1;
+
+	bool Touches(const IndexRange& a, const IndexRange& b)
+	{
+		return !a.Empty() && !b.Empty() && a.first <= b.last && b.first <= a.last;
+	}
+}
+
+Scene::Id::Id() noexcept
+	:
+	m_Value(nextSceneId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+Scene::Id& Scene::Id::operator=(const Id&) noexcept
+{
+	m_Value = nextSceneId.fetch_add(1, std::memory_order_relaxed);
+	return *this;
+}
+
+uint64_t Scene::GetId() const noexcept
+{
+	return m_Id.Get();
+}
+
+uint64_t Scene::GetVersion() const noexcept
+{
+	return m_Version;
+}
+
+uint64_t Scene::GetSphereVersion(uint32_t index) const noexcept
+{
+	return index < m_SphereVersions.size() ? m_SphereVersions[index] : 0;
+}
+
+uint64_t Scene::GetMaterialVersion(uint32_t index) const noexcept
+{
+	return index < m_MaterialVersions.size() ? m_MaterialVersions[index] : 0;
+}
+
+SceneChanges Scene::GetChanges(uint64_t sinceVersion) const
+{
+	SceneChanges changes;
+	for (auto it = m_Changes.rbegin(); it != m_Changes.rend() && it->version > sinceVersion; ++it) {
+		changes.spheres.Merge(it->changes.spheres);
+		changes.materials.Merge(it->changes.materials);
+	}
+	return changes;
+}
+
+void Scene::SetSphere(uint32_t index, const Sphere& sphere)
+{
+	spheres[index] = sphere;
+	RecordChange({ { index, index + 1 }, {} });
+	m_SphereVersions.resize(spheres.size(), 0);
+	m_SphereVersions[index] = m_Version;
+}
+
+void Scene::SetMaterial(uint32_t index, const Material& material)
+{
+	materials[index] = material;
+	RecordChange({ {}, { index, index + 1 } });
+	m_MaterialVersions.resize(materials.size(), 0);
+	m_MaterialVersions[index] = m_Version;
+}
+
+void Scene::RecordChange(const SceneChanges& change)
+{
+	++m_Version;
+
+	// Growing the newest entry instead of appending is safe: a consumer that
+	// already saw it sees it again under the new version, with a superset.
+	if (!m_Changes.empty()) {
+		SceneChanges& last = m_Changes.back().changes;
+		const bool spheresOnly = change.materials.Empty() && last.materials.Empty();
+		const bool materialsOnly = change.spheres.Empty() && last.spheres.Empty();
+		if ((spheresOnly && Touches(last.spheres, change.spheres)) || (materialsOnly && Touches(last.materials, change.materials))) {
+			last.spheres.Merge(change.spheres);
+			last.materials.Merge(change.materials);
+			m_Changes.back().version = m_Version;
+			return;
+		}
+	}
+
+	// A full log folds into one entry covering everything in it.
+	if (m_Changes.size() == maxChanges) {
+		SceneChanges all;
+		for (const Change& entry : m_Changes) {
+			all.spheres.Merge(entry.changes.spheres);
+			all.materials.Merge(entry.changes.materials);
+		}
+		m_Changes.assign(1, { m_Version - 1, all });
+	}
+	m_Changes.push_back({ m_Version, change });
+}
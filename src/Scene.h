@@ -1,12 +1,19 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <memory>
 #include <vector>
+#include <cstdint>
+
+class EnvironmentMap;
 
 struct Material {
 	DirectX::XMFLOAT4 Albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
 	float Roughness = 1.0f;
 	float Metallic = 0.0f;
+	DirectX::XMFLOAT3 Emission = { 0.0f, 0.0f, 0.0f }; // radiance leaving the surface
+
+	bool IsEmissive() const noexcept { return Emission.x > 0.0f || Emission.y > 0.0f || Emission.z > 0.0f; }
 };
 
 struct Sphere {
@@ -15,7 +22,77 @@ struct Sphere {
 	int materialIndex = 0;
 };
 
-struct Scene {
+// Half-open range of element indices, empty while first >= last.
+struct IndexRange {
+	uint32_t first = UINT32_MAX;
+	uint32_t last = 0;
+
+	bool Empty() const noexcept { return first >= last; }
+	void Add(uint32_t index) noexcept { Merge({ index, index + 1 }); }
+	void Merge(const IndexRange& other) noexcept {
+		if (other.Empty()) {
+			return;
+		}
+		first = first < other.first ? first : other.first;
+		last = last > other.last ? last : other.last;
+	}
+};
+
+// What changed in a scene since some version, as a consumer of GetChanges sees it.
+struct SceneChanges {
+	IndexRange spheres;
+	IndexRange materials;
+
+	bool Empty() const noexcept { return spheres.Empty() && materials.Empty(); }
+};
+
+// Spheres and materials are filled in directly while a scene is put together.
+// Once something renders it, edits go through SetSphere and SetMaterial, which
+// version them so consumers can update only what changed. Adding or removing
+// elements is not tracked; consumers treat a size change as a new scene.
+class Scene {
+public:
 	std::vector<Sphere> spheres;
 	std::vector<Material> materials;
-};
\ No newline at end of file
+	// Lights the rays that miss every sphere; without one they see a constant
+	// sky and the directional light. Not versioned: renderers compare the pointer.
+	std::shared_ptr<const EnvironmentMap> environment;
+
+	// Unique per Scene object: copies and assignments are different scenes.
+	uint64_t GetId() const noexcept;
+	// Bumped by every edit; 0 for a scene that was never edited.
+	uint64_t GetVersion() const noexcept;
+	// Version of the last edit to one element, 0 if never edited.
+	uint64_t GetSphereVersion(uint32_t index) const noexcept;
+	uint64_t GetMaterialVersion(uint32_t index) const noexcept;
+	// Everything edited after the given version. Ranges may cover untouched
+	// elements too, never fewer than were edited.
+	SceneChanges GetChanges(uint64_t sinceVersion) const;
+
+	void SetSphere(uint32_t index, const Sphere& sphere);
+	void SetMaterial(uint32_t index, const Material& material);
+private:
+	class Id {
+	public:
+		Id() noexcept;
+		Id(const Id&) noexcept : Id() {}
+		Id& operator=(const Id&) noexcept;
+		uint64_t Get() const noexcept { return m_Value; }
+	private:
+		uint64_t m_Value;
+	};
+	struct Change {
+		uint64_t version;
+		SceneChanges changes;
+	};
+	void RecordChange(const SceneChanges& change);
+private:
+	// Consecutive edits that touch the same elements share one entry, so
+	// dragging a value in the UI does not grow the log.
+	static constexpr size_t maxChanges = 64;
+	Id m_Id;
+	uint64_t m_Version = 0;
+	std::vector<uint64_t> m_SphereVersions;
+	std::vector<uint64_t> m_MaterialVersions;
+	std::vector<Change> m_Changes; // ascending versions
+};
@@ -0,0 +1,120 @@
+#include "SceneFile.h"
+#include "EnvironmentMap.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+SceneDescription DefaultSceneDescription()
+{
+	SceneDescription description;
+	Scene& scene = description.scene;
+
+	Material& orangeSphere = scene.materials.emplace_back();
+	orangeSphere.Albedo = { 1.0f, 0.55f, 0.0f, 1.0f };
+	orangeSphere.Roughness = 0.0f;
+
+	Material& blueSphere = scene.materials.emplace_back();
+	blueSphere.Albedo = { 0.2f, 0.3f, 1.0f, 1.0f };
+	blueSphere.Roughness = 0.1f;
+
+	{
+		Sphere sphere;
+		sphere.position = { 0.0f, 0.0f, 0.0f };
+		sphere.radius = 1.0f;
+		sphere.materialIndex = 0;
+		scene.spheres.push_back(sphere);
+	}
+
+	{
+		Sphere sphere;
+		sphere.position = { 0.0f, 101.0f, 0.0f };
+		sphere.radius = 100.0f;
+		sphere.materialIndex = 1;
+		scene.spheres.push_back(sphere);
+	}
+
+	return description;
+}
+
+SceneDescription LoadSceneDescription(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file) {
+		throw std::runtime_error("Failed to open scene " + path);
+	}
+
+	SceneDescription description;
+	Scene& scene = description.scene;
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream tokens(line);
+		std::string keyword;
+		if (!(tokens >> keyword)) {
+			continue;
+		}
+
+		auto fail = [&](const char* message) {
+			return std::runtime_error(path + ":" + std::to_string(lineNumber) + ": " + message);
+		};
+
+		if (keyword == "material") {
+			Material material;
+			if (!(tokens >> material.Albedo.x >> material.Albedo.y >> material.Albedo.z >> material.Roughness)) {
+				throw fail("expected 'material r g b roughness [metallic [er eg eb]]'");
+			}
+			if (!(tokens >> material.Metallic)) {
+				material.Metallic = 0.0f;
+			}
+			else if (tokens >> material.Emission.x && !(tokens >> material.Emission.y >> material.Emission.z)) {
+				throw fail("expected 'material r g b roughness [metallic [er eg eb]]'");
+			}
+			scene.materials.push_back(material);
+		}
+		else if (keyword == "sphere") {
+			Sphere sphere;
+			if (!(tokens >> sphere.position.x >> sphere.position.y >> sphere.position.z >> sphere.radius >> sphere.materialIndex)) {
+				throw fail("expected 'sphere x y z radius materialIndex'");
+			}
+			scene.spheres.push_back(sphere);
+		}
+		else if (keyword == "camera") {
+			DirectX::XMFLOAT3& p = description.cameraPosition;
+			DirectX::XMFLOAT3& d = description.cameraDirection;
+			if (!(tokens >> p.x >> p.y >> p.z >> d.x >> d.y >> d.z)) {
+				throw fail("expected 'camera px py pz dx dy dz [verticalFov]'");
+			}
+			if (!(tokens >> description.verticalFov)) {
+				description.verticalFov = 45.0f;
+			}
+		}
+		else if (keyword == "environment") {
+			std::string environmentPath;
+			float scale = 1.0f;
+			if (!(tokens >> environmentPath)) {
+				throw fail("expected 'environment path [scale]'");
+			}
+			if (!(tokens >> scale)) {
+				scale = 1.0f;
+			}
+			try {
+				scene.environment = std::make_shared<EnvironmentMap>((std::filesystem::path(path).parent_path() / environmentPath).string(), scale);
+			}
+			catch (const std::runtime_error& error) {
+				throw fail(error.what());
+			}
+		}
+		else {
+			throw fail(("unknown statement '" + keyword + "'").c_str());
+		}
+	}
+
+	for (const Sphere& sphere : scene.spheres) {
+		if (sphere.materialIndex < 0 || sphere.materialIndex >= (int)scene.materials.size()) {
+			throw std::runtime_error(path + ": sphere material index " + std::to_string(sphere.materialIndex) + " out of range");
+		}
+	}
+	return description;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Scene.h"
+#include <DirectXMath.h>
+#include <string>
+
+// A scene together with the camera that frames it, as batch renders consume them.
+struct SceneDescription {
+	Scene scene;
+	DirectX::XMFLOAT3 cameraPosition = { 0.0f, 0.0f, -6.0f };
+	DirectX::XMFLOAT3 cameraDirection = { 0.0f, 0.0f, 1.0f };
+	float verticalFov = 45.0f; // degrees
+};
+
+// The two-sphere scene the app opens with.
+SceneDescription DefaultSceneDescription();
+
+// Reads a text scene, one statement per line, '#' starts a comment:
+//   material r g b roughness [metallic [er eg eb]]
+//   sphere x y z radius materialIndex
+//   camera px py pz dx dy dz [verticalFov]
+//   environment path [scale]   (equirectangular PFM, relative to the scene file)
+// Throws std::runtime_error naming the file and line on malformed input.
+SceneDescription LoadSceneDescription(const std::string& path);
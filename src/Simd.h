@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <math.h>
+
+#if defined(__AVX2__)
+#define RT_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RT_SIMD_WIDTH 4
+#else
+#define RT_SIMD_WIDTH 1
+#endif
+
+#if RT_SIMD_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+// Thin wrappers over the widest float vector the build targets, so kernels
+// that run across rays or pixels are written once for AVX2, SSE2 and scalar.
+namespace Simd
+{
+	constexpr uint32_t width = RT_SIMD_WIDTH;
+
+#if RT_SIMD_WIDTH == 8
+	struct Float { __m256 v; };
+	struct Int { __m256i v; };
+	struct Mask { __m256 v; };
+
+	inline Float Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+	inline Int Load(const int32_t* p) { return { _mm256_loadu_si256((const __m256i*)p) }; }
+	inline void Store(float* p, Float a) { _mm256_storeu_ps(p, a.v); }
+	inline void Store(int32_t* p, Int a) { _mm256_storeu_si256((__m256i*)p, a.v); }
+	inline Float Broadcast(float s) { return { _mm256_set1_ps(s) }; }
+	inline Int Broadcast(int32_t s) { return { _mm256_set1_epi32(s) }; }
+	inline Int LaneIndex() { return { _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7) }; }
+
+	inline Float operator+(Float a, Float b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline Float operator-(Float a, Float b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline Float operator*(Float a, Float b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline Float operator/(Float a, Float b) { return { _mm256_div_ps(a.v, b.v) }; }
+	inline Float operator-(Float a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+	inline Int operator+(Int a, Int b) { return { _mm256_add_epi32(a.v, b.v) }; }
+	inline Float Min(Float a, Float b) { return { _mm256_min_ps(a.v, b.v) }; }
+	inline Float Max(Float a, Float b) { return { _mm256_max_ps(a.v, b.v) }; }
+	inline Float Sqrt(Float a) { return { _mm256_sqrt_ps(a.v) }; }
+	inline float ReduceMin(Float a) {
+		__m256 m = _mm256_min_ps(a.v, _mm256_permute2f128_ps(a.v, a.v, 1));
+		m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+		m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm256_cvtss_f32(m);
+	}
+
+	inline Mask operator<(Float a, Float b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+	inline Mask operator<=(Float a, Float b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+	inline Mask operator>=(Float a, Float b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+	inline Mask operator==(Float a, Float b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+	inline Mask operator<(Int a, Int b) { return { _mm256_castsi256_ps(_mm256_cmpgt_epi32(b.v, a.v)) }; }
+	inline Mask operator&(Mask a, Mask b) { return { _mm256_and_ps(a.v, b.v) }; }
+	inline Mask operator|(Mask a, Mask b) { return { _mm256_or_ps(a.v, b.v) }; }
+	inline bool Any(Mask m) { return _mm256_movemask_ps(m.v) != 0; }
+	inline uint32_t Bits(Mask m) { return (uint32_t)_mm256_movemask_ps(m.v); }
+
+	inline Float Select(Mask m, Float a, Float b) { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+	inline Int Select(Mask m, Int a, Int b) {
+		return { _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b.v), _mm256_castsi256_ps(a.v), m.v)) };
+	}
+#elif RT_SIMD_WIDTH == 4
+	struct Float { __m128 v; };
+	struct Int { __m128i v; };
+	struct Mask { __m128 v; };
+
+	inline Float Load(const float* p) { return { _mm_loadu_ps(p) }; }
+	inline Int Load(const int32_t* p) { return { _mm_loadu_si128((const __m128i*)p) }; }
+	inline void Store(float* p, Float a) { _mm_storeu_ps(p, a.v); }
+	inline void Store(int32_t* p, Int a) { _mm_storeu_si128((__m128i*)p, a.v); }
+	inline Float Broadcast(float s) { return { _mm_set1_ps(s) }; }
+	inline Int Broadcast(int32_t s) { return { _mm_set1_epi32(s) }; }
+	inline Int LaneIndex() { return { _mm_setr_epi32(0, 1, 2, 3) }; }
+
+	inline Float operator+(Float a, Float b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline Float operator-(Float a, Float b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline Float operator*(Float a, Float b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline Float operator/(Float a, Float b) { return { _mm_div_ps(a.v, b.v) }; }
+	inline Float operator-(Float a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+	inline Int operator+(Int a, Int b) { return { _mm_add_epi32(a.v, b.v) }; }
+	inline Float Min(Float a, Float b) { return { _mm_min_ps(a.v, b.v) }; }
+	inline Float Max(Float a, Float b) { return { _mm_max_ps(a.v, b.v) }; }
+	inline Float Sqrt(Float a) { return { _mm_sqrt_ps(a.v) }; }
+	inline float ReduceMin(Float a) {
+		__m128 m = _mm_min_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+		m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(m);
+	}
+
+	inline Mask operator<(Float a, Float b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+	inline Mask operator<=(Float a, Float b) { return { _mm_cmple_ps(a.v, b.v) }; }
+	inline Mask operator>=(Float a, Float b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+	inline Mask operator==(Float a, Float b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+	inline Mask operator<(Int a, Int b) { return { _mm_castsi128_ps(_mm_cmplt_epi32(a.v, b.v)) }; }
+	inline Mask operator&(Mask a, Mask b) { return { _mm_and_ps(a.v, b.v) }; }
+	inline Mask operator|(Mask a, Mask b) { return { _mm_or_ps(a.v, b.v) }; }
+	inline bool Any(Mask m) { return _mm_movemask_ps(m.v) != 0; }
+	inline uint32_t Bits(Mask m) { return (uint32_t)_mm_movemask_ps(m.v); }
+
+	// SSE2 has no blendv: (m & a) | (~m & b)
+	inline Float Select(Mask m, Float a, Float b) { return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) }; }
+	inline Int Select(Mask m, Int a, Int b) {
+		const __m128i mi = _mm_castps_si128(m.v);
+		return { _mm_or_si128(_mm_and_si128(mi, a.v), _mm_andnot_si128(mi, b.v)) };
+	}
+#else
+	struct Float { float v; };
+	struct Int { int32_t v; };
+	struct Mask { bool v; };
+
+	inline Float Load(const float* p) { return { *p }; }
+	inline Int Load(const int32_t* p) { return { *p }; }
+	inline void Store(float* p, Float a) { *p = a.v; }
+	inline void Store(int32_t* p, Int a) { *p = a.v; }
+	inline Float Broadcast(float s) { return { s }; }
+	inline Int Broadcast(int32_t s) { return { s }; }
+	inline Int LaneIndex() { return { 0 }; }
+
+	inline Float operator+(Float a, Float b) { return { a.v + b.v }; }
+	inline Float operator-(Float a, Float b) { return { a.v - b.v }; }
+	inline Float operator*(Float a, Float b) { return { a.v * b.v }; }
+	inline Float operator/(Float a, Float b) { return { a.v / b.v }; }
+	inline Float operator-(Float a) { return { -a.v }; }
+	inline Int operator+(Int a, Int b) { return { a.v + b.v }; }
+	inline Float Min(Float a, Float b) { return { a.v < b.v ? a.v : b.v }; }
+	inline Float Max(Float a, Float b) { return { a.v > b.v ? a.v : b.v }; }
+	inline Float Sqrt(Float a) { return { sqrtf(a.v) }; }
+	inline float ReduceMin(Float a) { return a.v; }
+
+	inline Mask operator<(Float a, Float b) { return { a.v < b.v }; }
+	inline Mask operator<=(Float a, Float b) { return { a.v <= b.v }; }
+	inline Mask operator>=(Float a, Float b) { return { a.v >= b.v }; }
+	inline Mask operator==(Float a, Float b) { return { a.v == b.v }; }
+	inline Mask operator<(Int a, Int b) { return { a.v < b.v }; }
+	inline Mask operator&(Mask a, Mask b) { return { a.v && b.v }; }
+	inline Mask operator|(Mask a, Mask b) { return { a.v || b.v }; }
+	inline bool Any(Mask m) { return m.v; }
+	inline uint32_t Bits(Mask m) { return m.v ? 1u : 0u; }
+
+	inline Float Select(Mask m, Float a, Float b) { return m.v ? a : b; }
+	inline Int Select(Mask m, Int a, Int b) { return m.v ? a : b; }
+#endif
+}
@@ -0,0 +1,207 @@
+#include "SphereSoA.h"
+
+#include <bit>
+#include <math.h>
+
+void SphereSoA::Build(const std::vector<Sphere>& spheres)
+{
+	Resize((uint32_t)spheres.size());
+	for (uint32_t i = 0; i < m_Size; ++i) {
+		Set(i, spheres[i]);
+	}
+}
+
+void SphereSoA::Build(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& order)
+{
+	Resize((uint32_t)order.size());
+	for (uint32_t i = 0; i < m_Size; ++i) {
+		Set(i, spheres[order[i]]);
+	}
+}
+
+void SphereSoA::Set(uint32_t index, const Sphere& sphere) noexcept
+{
+	m_CenterX[index] = sphere.position.x;
+	m_CenterY[index] = sphere.position.y;
+	m_CenterZ[index] = sphere.position.z;
+	m_RadiusSq[index] = sphere.radius * sphere.radius;
+}
+
+void SphereSoA::GetBounds(uint32_t index, DirectX::XMFLOAT3& center, float& radius) const noexcept
+{
+	center = { m_CenterX[index], m_CenterY[index], m_CenterZ[index] };
+	radius = sqrtf(m_RadiusSq[index]);
+}
+
+void SphereSoA::Clear() noexcept
+{
+	m_Size = 0;
+	m_CenterX.clear();
+	m_CenterY.clear();
+	m_CenterZ.clear();
+	m_RadiusSq.clear();
+}
+
+uint32_t SphereSoA::Size() const noexcept
+{
+	return m_Size;
+}
+
+void SphereSoA::Resize(uint32_t size)
+{
+	m_Size = size;
+	// Padding lanes have r^2 = -inf, which makes the discriminant -inf.
+	m_CenterX.assign(size + simdWidth, 0.0f);
+	m_CenterY.assign(size + simdWidth, 0.0f);
+	m_CenterZ.assign(size + simdWidth, 0.0f);
+	m_RadiusSq.assign(size + simdWidth, -INFINITY);
+}
+
+int SphereSoA::Intersect(const Ray& ray, float& hitDistance) const
+{
+	return Intersect(ray, hitDistance, 0u, m_Size);
+}
+
+bool SphereSoA::Occluded(const Ray& ray, float tMax) const
+{
+	return Occluded(ray, tMax, 0u, m_Size);
+}
+
+bool SphereSoA::Occluded(const Ray& ray, float tMax, uint32_t first, uint32_t count) const
+{
+	using namespace Simd;
+
+	const Float zero = Broadcast(0.0f);
+	const Float ox = Broadcast(ray.origin.x);
+	const Float oy = Broadcast(ray.origin.y);
+	const Float oz = Broadcast(ray.origin.z);
+	const Float dx = Broadcast(ray.direction.x);
+	const Float dy = Broadcast(ray.direction.y);
+	const Float dz = Broadcast(ray.direction.z);
+	const float aScalar = ray.direction.x * ray.direction.x + ray.direction.y * ray.direction.y + ray.direction.z * ray.direction.z;
+	const Float a = Broadcast(aScalar);
+	// Compared pre-division (t * a) like Intersect.
+	const Float limit = Broadcast(tMax * aScalar);
+	const Int end = Broadcast((int32_t)(first + count));
+	const Int step = Broadcast((int32_t)width);
+	Int index = Broadcast((int32_t)first) + LaneIndex();
+
+	for (uint32_t i = first; i < first + count; i += width) {
+		const Float px = ox - Load(&m_CenterX[i]);
+		const Float py = oy - Load(&m_CenterY[i]);
+		const Float pz = oz - Load(&m_CenterZ[i]);
+
+		const Float halfB = px * dx + py * dy + pz * dz;
+		const Float c = px * px + py * py + pz * pz - Load(&m_RadiusSq[i]);
+		const Float D = halfB * halfB - a * c;
+		const Mask mask = (D >= zero) & (index < end);
+		if (Any(mask)) {
+			const Float t = -halfB - Sqrt(Max(D, zero));
+			if (Any(mask & (t >= zero) & (t < limit))) {
+				return true;
+			}
+		}
+		index = index + step;
+	}
+	return false;
+}
+
+void SphereSoA::IntersectPacket(RayPacket& packet) const
+{
+	IntersectPacket(packet, 0u, m_Size, packet.GroupMask());
+}
+
+void SphereSoA::IntersectPacket(RayPacket& packet, uint32_t first, uint32_t count, uint64_t groupMask) const
+{
+	using namespace Simd;
+
+	const Float zero = Broadcast(0.0f);
+
+	for (uint32_t i = first; i < first + count; ++i) {
+		// Every ray starts at the packet origin, so the origin term of the
+		// quadratic is computed once per sphere instead of once per ray.
+		const float ocx = packet.origin.x - m_CenterX[i];
+		const float ocy = packet.origin.y - m_CenterY[i];
+		const float ocz = packet.origin.z - m_CenterZ[i];
+		const Float c = Broadcast(ocx * ocx + ocy * ocy + ocz * ocz - m_RadiusSq[i]);
+		const Float ox = Broadcast(ocx);
+		const Float oy = Broadcast(ocy);
+		const Float oz = Broadcast(ocz);
+		const Int sphereIndex = Broadcast((int32_t)i);
+
+		for (uint64_t groups = groupMask; groups != 0; groups &= groups - 1) {
+			const uint32_t lane = (uint32_t)std::countr_zero(groups) * width;
+
+			const Float dx = Load(&packet.directionX[lane]);
+			const Float dy = Load(&packet.directionY[lane]);
+			const Float dz = Load(&packet.directionZ[lane]);
+
+			// a is ~1 for normalized directions but kept exact so grazing hits agree with single-ray tracing.
+			const Float a = dx * dx + dy * dy + dz * dz;
+			const Float halfB = ox * dx + oy * dy + oz * dz;
+			const Float D = halfB * halfB - a * c;
+			Mask mask = D >= zero;
+			if (!Any(mask)) {
+				continue;
+			}
+
+			const Float t = (-halfB - Sqrt(Max(D, zero))) / a;
+			const Float best = Load(&packet.hitDistance[lane]);
+			mask = mask & (t >= zero) & (t < best);
+
+			Store(&packet.hitDistance[lane], Select(mask, t, best));
+			Store(&packet.objectIndex[lane], Select(mask, sphereIndex, Load(&packet.objectIndex[lane])));
+		}
+	}
+}
+
+int SphereSoA::Intersect(const Ray& ray, float& hitDistance, uint32_t first, uint32_t count) const
+{
+	using namespace Simd;
+
+	const Float zero = Broadcast(0.0f);
+	const Float ox = Broadcast(ray.origin.x);
+	const Float oy = Broadcast(ray.origin.y);
+	const Float oz = Broadcast(ray.origin.z);
+	const Float dx = Broadcast(ray.direction.x);
+	const Float dy = Broadcast(ray.direction.y);
+	const Float dz = Broadcast(ray.direction.z);
+	const float aScalar = ray.direction.x * ray.direction.x + ray.direction.y * ray.direction.y + ray.direction.z * ray.direction.z;
+	const Float a = Broadcast(aScalar);
+
+	// Distances are compared pre-division (t * a) since a is shared by every lane.
+	Float bestT = Broadcast(hitDistance * aScalar);
+	Int bestIndex = Broadcast(-1);
+	const Int end = Broadcast((int32_t)(first + count));
+	const Int step = Broadcast((int32_t)width);
+	Int index = Broadcast((int32_t)first) + LaneIndex();
+
+	for (uint32_t i = first; i < first + count; i += width) {
+		const Float px = ox - Load(&m_CenterX[i]);
+		const Float py = oy - Load(&m_CenterY[i]);
+		const Float pz = oz - Load(&m_CenterZ[i]);
+
+		const Float halfB = px * dx + py * dy + pz * dz;
+		const Float c = px * px + py * py + pz * pz - Load(&m_RadiusSq[i]);
+		const Float D = halfB * halfB - a * c;
+		Mask mask = (D >= zero) & (index < end);
+		if (Any(mask)) {
+			const Float t = -halfB - Sqrt(Max(D, zero));
+			mask = mask & (t >= zero) & (t < bestT);
+			bestT = Select(mask, t, bestT);
+			bestIndex = Select(mask, index, bestIndex);
+		}
+		index = index + step;
+	}
+
+	const float minT = ReduceMin(bestT);
+	const uint32_t lane = (uint32_t)std::countr_zero(Bits(bestT == Broadcast(minT)));
+	int32_t indices[width];
+	Store(indices, bestIndex);
+	if (indices[lane] < 0) {
+		return -1;
+	}
+
+	hitDistance = minT / aScalar;
+	return indices[lane];
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Scene.h"
+#include "Simd.h"
+#include <vector>
+#include <cstdint>
+
+// Structure-of-arrays mirror of sphere data (center and squared radius) for
+// SIMD intersection. Arrays are padded by one SIMD width with spheres that
+// can never be hit, so kernels may always load full lanes.
+class SphereSoA {
+public:
+	static constexpr uint32_t simdWidth = Simd::width;
+public:
+	void Build(const std::vector<Sphere>& spheres);
+	// Stores spheres[order[i]] at slot i.
+	void Build(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& order);
+	void Set(uint32_t index, const Sphere& sphere) noexcept;
+	// Center and radius as last Set; the material is not mirrored.
+	void GetBounds(uint32_t index, DirectX::XMFLOAT3& center, float& radius) const noexcept;
+	void Clear() noexcept;
+	uint32_t Size() const noexcept;
+	// Closest hit among slots [first, first + count) that is nearer than hitDistance.
+	// Returns the slot index or -1, updating hitDistance on a hit.
+	int Intersect(const Ray& ray, float& hitDistance, uint32_t first, uint32_t count) const;
+	int Intersect(const Ray& ray, float& hitDistance) const;
+	// Whether any slot in [first, first + count) is hit closer than tMax. Stops at
+	// the first SIMD group with a hit instead of searching for the closest.
+	bool Occluded(const Ray& ray, float tMax, uint32_t first, uint32_t count) const;
+	bool Occluded(const Ray& ray, float tMax) const;
+	// Same query for every ray of a packet, restricted to the SIMD lane groups set
+	// in groupMask. Hits go to packet.hitDistance/objectIndex as slot indices.
+	void IntersectPacket(RayPacket& packet, uint32_t first, uint32_t count, uint64_t groupMask) const;
+	void IntersectPacket(RayPacket& packet) const;
+private:
+	void Resize(uint32_t size);
+private:
+	uint32_t m_Size = 0;
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_RadiusSq;
+};
@@ -0,0 +1,172 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <string>
+
+ThreadPool::ThreadPool(uint32_t nThreads)
+{
+	Start(nThreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	Stop();
+}
+
+void ThreadPool::SetThreadCount(uint32_t nThreads)
+{
+	if (nThreads == 0) {
+		nThreads = HardwareThreadCount();
+	}
+	if (nThreads == GetThreadCount()) {
+		return;
+	}
+	Stop();
+	Start(nThreads);
+}
+
+uint32_t ThreadPool::GetThreadCount() const noexcept
+{
+	return (uint32_t)m_Threads.size();
+}
+
+uint32_t ThreadPool::GetLastStealCount() const noexcept
+{
+	return m_Steals.load(std::memory_order_relaxed);
+}
+
+uint32_t ThreadPool::HardwareThreadCount() noexcept
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const Task& task)
+{
+	if (count == 0) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_Task = &task;
+		m_Remaining.store(count, std::memory_order_relaxed);
+		m_Steals.store(0, std::memory_order_relaxed);
+
+		const uint32_t nWorkers = (uint32_t)m_Workers.size();
+		for (uint32_t w = 0; w < nWorkers; ++w) {
+			const uint32_t first = (uint32_t)((uint64_t)count * w / nWorkers);
+			const uint32_t last = (uint32_t)((uint64_t)count * (w + 1) / nWorkers);
+
+			std::lock_guard<std::mutex> workerLock(m_Workers[w]->mutex);
+			for (uint32_t i = first; i < last; ++i) {
+				m_Workers[w]->tasks.push_back(i);
+			}
+		}
+
+		++m_Generation;
+	}
+	m_WakeCondition.notify_all();
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_DoneCondition.wait(lock, [this] {
+		return m_Remaining.load(std::memory_order_acquire) == 0 && m_ActiveWorkers == 0;
+	});
+	m_Task = nullptr;
+}
+
+void ThreadPool::Start(uint32_t nThreads)
+{
+	if (nThreads == 0) {
+		nThreads = HardwareThreadCount();
+	}
+
+	m_Stopping = false;
+	m_Workers.clear();
+	for (uint32_t i = 0; i < nThreads; ++i) {
+		m_Workers.push_back(std::make_unique<Worker>());
+	}
+	for (uint32_t i = 0; i < nThreads; ++i) {
+		m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+void ThreadPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (std::thread& thread : m_Threads) {
+		thread.join();
+	}
+	m_Threads.clear();
+	m_Workers.clear();
+}
+
+void ThreadPool::WorkerLoop(uint32_t worker)
+{
+	Profiler::SetThreadName(("Worker " + std::to_string(worker)).c_str());
+
+	uint64_t generation = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeCondition.wait(lock, [&] { return m_Stopping || m_Generation != generation; });
+			if (m_Stopping) {
+				return;
+			}
+			generation = m_Generation;
+			++m_ActiveWorkers;
+		}
+
+		uint32_t index = 0;
+		while (Pop(worker, index) || Steal(worker, index)) {
+			(*m_Task)(index, worker);
+			m_Remaining.fetch_sub(1, std::memory_order_release);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			--m_ActiveWorkers;
+			if (m_ActiveWorkers == 0 && m_Remaining.load(std::memory_order_acquire) == 0) {
+				m_DoneCondition.notify_all();
+			}
+		}
+	}
+}
+
+bool ThreadPool::Pop(uint32_t worker, uint32_t& index)
+{
+	Worker& self = *m_Workers[worker];
+	std::lock_guard<std::mutex> lock(self.mutex);
+	if (self.tasks.empty()) {
+		return false;
+	}
+	// Own work is taken front to back so consecutive tiles stay on one core.
+	index = self.tasks.front();
+	self.tasks.pop_front();
+	return true;
+}
+
+bool ThreadPool::Steal(uint32_t worker, uint32_t& index)
+{
+	const uint32_t nWorkers = (uint32_t)m_Workers.size();
+	for (uint32_t offset = 1; offset < nWorkers; ++offset) {
+		Worker& victim = *m_Workers[(worker + offset) % nWorkers];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.tasks.empty()) {
+			continue;
+		}
+		// Thieves take from the far end, away from where the owner is working.
+		index = victim.tasks.back();
+		victim.tasks.pop_back();
+		m_Steals.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
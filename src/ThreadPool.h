@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task deque each. ParallelFor hands every
+// worker a contiguous run of indices (spatially coherent tiles for the renderer);
+// a worker that runs dry steals from the back of another worker's deque.
+class ThreadPool {
+public:
+	using Task = std::function<void(uint32_t index, uint32_t worker)>;
+public:
+	explicit ThreadPool(uint32_t nThreads = 0); // 0 = one per hardware thread
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+	void SetThreadCount(uint32_t nThreads);
+	uint32_t GetThreadCount() const noexcept;
+	// Runs task for every index in [0, count) and blocks until all of them finished.
+	void ParallelFor(uint32_t count, const Task& task);
+	// Number of indices taken from another worker's deque during the last ParallelFor.
+	uint32_t GetLastStealCount() const noexcept;
+	static uint32_t HardwareThreadCount() noexcept;
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<uint32_t> tasks;
+	};
+	void Start(uint32_t nThreads);
+	void Stop();
+	void WorkerLoop(uint32_t worker);
+	bool Pop(uint32_t worker, uint32_t& index);
+	bool Steal(uint32_t worker, uint32_t& index);
+private:
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::vector<std::thread> m_Threads;
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeCondition;
+	std::condition_variable m_DoneCondition;
+	const Task* m_Task = nullptr;
+	uint64_t m_Generation = 0;
+	uint32_t m_ActiveWorkers = 0;
+	bool m_Stopping = false;
+	std::atomic<uint32_t> m_Remaining = 0;
+	std::atomic<uint32_t> m_Steals = 0;
+};
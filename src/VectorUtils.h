@@ -3,7 +3,6 @@
 #include <DirectXMath.h>
 #include <math.h>
 #include <algorithm>
-#include <random>
 
 namespace Utils 
 {
@@ -61,6 +60,14 @@ namespace Utils
 		};
 	}
 
+	inline DirectX::XMFLOAT3 Multiply(const DirectX::XMFLOAT3& v1, const DirectX::XMFLOAT3& v2) {
+		return {
+			v1.x * v2.x,
+			v1.y * v2.y,
+			v1.z * v2.z,
+		};
+	}
+
 	inline DirectX::XMFLOAT4 Scale(const DirectX::XMFLOAT4& v1, float scalar) {
 		return {
 			v1.x * scalar,
@@ -101,6 +108,16 @@ namespace Utils
 		return Subtract(v, Scale(normal, 2.0f * Dot(v, normal)));
 	}
 
+	// Tangent and bitangent completing a frame around a unit normal (Duff et al.,
+	// "Building an Orthonormal Basis, Revisited", JCGT 2017).
+	inline void OrthonormalBasis(const DirectX::XMFLOAT3& n, DirectX::XMFLOAT3& tangent, DirectX::XMFLOAT3& bitangent) {
+		const float sign = copysignf(1.0f, n.z);
+		const float a = -1.0f / (sign + n.z);
+		const float b = n.x * n.y * a;
+		tangent = { 1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+		bitangent = { b, sign + n.y * n.y * a, -n.y };
+	}
+
 	inline DirectX::XMFLOAT3 ToFloat3(const DirectX::XMFLOAT4& v) {
 		return { v.x, v.y, v.z };
 	}
@@ -109,11 +126,25 @@ namespace Utils
 		return { v.x, v.y, v.z, w };
 	}
 
-	inline DirectX::XMFLOAT3 RandomFloat3(float min, float max) {
-		static thread_local std::random_device rd;
-		static thread_local std::mt19937 generator(rd());
-		static thread_local std::uniform_real_distribution<float> dist(min, max);
+	// Rec. 709 relative luminance.
+	inline float Luminance(const DirectX::XMFLOAT3& v) {
+		return 0.2126f * v.x + 0.7152f * v.y + 0.0722f * v.z;
+	}
+
+	// Filmic curve fitted to the ACES reference rendering and output transforms
+	// (Narkowicz, "ACES Filmic Tone Mapping Curve", 2015); [0, inf) to [0, 1].
+	inline float TonemapAces(float x) {
+		x = std::max(x, 0.0f);
+		return std::min(x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f), 1.0f);
+	}
+
+	// sRGB transfer function, linear [0, 1] to encoded [0, 1].
+	inline float EncodeSrgb(float x) {
+		return x <= 0.0031308f ? 12.92f * x : 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+	}
 
-		return { dist(generator) , dist(generator), dist(generator) };
+	// Linear radiance as the app displays it and PNGs store it.
+	inline DirectX::XMFLOAT4 DisplayTransform(const DirectX::XMFLOAT4& radiance) {
+		return { EncodeSrgb(TonemapAces(radiance.x)), EncodeSrgb(TonemapAces(radiance.y)), EncodeSrgb(TonemapAces(radiance.z)), 1.0f };
 	}
 }
\ No newline at end of file
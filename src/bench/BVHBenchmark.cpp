@@ -0,0 +1,217 @@
+// Compares BVH traversal and the SIMD SoA sphere loop against the scalar
+// brute-force loop TraceRay used before, then single rays against 8x8
+// packets for a coherent grid of camera rays.
+// Usage: bvh_benchmark [sphere counts...]   (default: 1000 100000 1000000)
+
+#include "BVH.h"
+#include "SphereSoA.h"
+#include "RayPacket.h"
+#include "Intersection.h"
+#include "VectorUtils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	Scene MakeRandomScene(size_t nSpheres, std::mt19937& rng)
+	{
+		// Keep the volume density roughly constant so every scene has a similar look.
+		const float extent = 10.0f * std::cbrt((float)nSpheres / 1000.0f);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> radius(0.05f, 0.4f);
+
+		Scene scene;
+		scene.materials.emplace_back();
+		scene.spheres.resize(nSpheres);
+		for (Sphere& sphere : scene.spheres) {
+			sphere.position = { position(rng), position(rng), position(rng) };
+			sphere.radius = radius(rng);
+		}
+		return scene;
+	}
+
+	std::vector<Ray> MakeRays(size_t nRays, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+		std::vector<Ray> rays(nRays);
+		for (Ray& ray : rays) {
+			ray.origin = { 0.0f, 0.0f, 0.0f };
+			do {
+				ray.direction = { direction(rng), direction(rng), direction(rng) };
+			} while (Utils::Dot(ray.direction, ray.direction) < 1e-4f);
+			ray.direction = Utils::Normalize(ray.direction);
+		}
+		return rays;
+	}
+
+	int BruteForce(const Scene& scene, const Ray& ray, float& hitDistance)
+	{
+		int closest = -1;
+		for (size_t i = 0; i < scene.spheres.size(); ++i) {
+			const float t = Utils::IntersectSphere(ray, scene.spheres[i]);
+			if (t >= 0.0f && t < hitDistance) {
+				hitDistance = t;
+				closest = (int)i;
+			}
+		}
+		return closest;
+	}
+
+	// Pinhole grid looking down +z from outside the sphere field, packed into 8x8 tiles.
+	std::vector<RayPacket> MakePrimaryPackets(const Scene& scene, uint32_t width, uint32_t height)
+	{
+		float extent = 0.0f;
+		for (const Sphere& sphere : scene.spheres) {
+			extent = std::max(extent, std::abs(sphere.position.z) + sphere.radius);
+		}
+
+		std::vector<RayPacket> packets;
+		for (uint32_t y0 = 0; y0 < height; y0 += RayPacket::tileSize) {
+			for (uint32_t x0 = 0; x0 < width; x0 += RayPacket::tileSize) {
+				RayPacket& packet = packets.emplace_back();
+				packet.origin = { 0.0f, 0.0f, -2.0f * extent };
+				packet.count = RayPacket::maxSize;
+				for (uint32_t i = 0; i < RayPacket::maxSize; ++i) {
+					const float u = ((float)(x0 + i % RayPacket::tileSize) / width) * 2.0f - 1.0f;
+					const float v = ((float)(y0 + i / RayPacket::tileSize) / height) * 2.0f - 1.0f;
+					const XMFLOAT3 direction = Utils::Normalize({ 0.5f * u, 0.5f * v, 1.0f });
+					packet.directionX[i] = direction.x;
+					packet.directionY[i] = direction.y;
+					packet.directionZ[i] = direction.z;
+					packet.hitDistance[i] = std::numeric_limits<float>::max();
+					packet.objectIndex[i] = -1;
+				}
+			}
+		}
+		return packets;
+	}
+
+	template<typename F>
+	double MeasureMs(F&& f)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		f();
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<size_t> sizes;
+	for (int i = 1; i < argc; ++i) {
+		sizes.push_back((size_t)std::strtoull(argv[i], nullptr, 10));
+	}
+	if (sizes.empty()) {
+		sizes = { 1000, 100000, 1000000 };
+	}
+
+	std::mt19937 rng(1337u);
+
+	std::printf("SIMD width: %u\n", SphereSoA::simdWidth);
+	std::printf("%10s %10s %10s %8s %10s %14s %14s %14s %10s %10s\n",
+		"spheres", "build ms", "nodes", "depth", "rays", "brute Mray/s", "soa Mray/s", "bvh Mray/s", "speedup", "mismatch");
+
+	for (size_t nSpheres : sizes) {
+		const Scene scene = MakeRandomScene(nSpheres, rng);
+
+		BVH bvh;
+		bvh.Build(scene);
+		const BVH::BuildStats& buildStats = bvh.GetBuildStats();
+
+		// Brute force is O(n) per ray, so scale its ray count to keep the run short.
+		const size_t nBruteRays = std::max<size_t>(256, 200000000 / nSpheres);
+		const size_t nBVHRays = 1000000;
+		const std::vector<Ray> rays = MakeRays(std::max(nBruteRays, nBVHRays), rng);
+
+		std::vector<int> bruteHits(nBruteRays);
+		std::vector<float> bruteDistances(nBruteRays);
+		const double bruteMs = MeasureMs([&] {
+			for (size_t i = 0; i < nBruteRays; ++i) {
+				bruteDistances[i] = std::numeric_limits<float>::max();
+				bruteHits[i] = BruteForce(scene, rays[i], bruteDistances[i]);
+			}
+		});
+
+		SphereSoA soa;
+		soa.Build(scene.spheres);
+
+		std::vector<int> soaHits(nBruteRays);
+		const double soaMs = MeasureMs([&] {
+			for (size_t i = 0; i < nBruteRays; ++i) {
+				float hitDistance = std::numeric_limits<float>::max();
+				soaHits[i] = soa.Intersect(rays[i], hitDistance);
+			}
+		});
+
+		std::vector<int> bvhHits(nBVHRays);
+		BVH::TraversalStats traversalStats;
+		const double bvhMs = MeasureMs([&] {
+			for (size_t i = 0; i < nBVHRays; ++i) {
+				float hitDistance = std::numeric_limits<float>::max();
+				bvhHits[i] = bvh.Intersect(rays[i], hitDistance, &traversalStats);
+			}
+		});
+
+		size_t mismatches = 0;
+		for (size_t i = 0; i < std::min(nBruteRays, nBVHRays); ++i) {
+			if (bruteHits[i] != bvhHits[i] || bruteHits[i] != soaHits[i]) {
+				++mismatches;
+			}
+		}
+
+		const double bruteRate = nBruteRays / bruteMs / 1000.0;
+		const double soaRate = nBruteRays / soaMs / 1000.0;
+		const double bvhRate = nBVHRays / bvhMs / 1000.0;
+		std::printf("%10zu %10.2f %10u %8u %10zu %14.3f %14.3f %14.3f %9.1fx %10zu\n",
+			nSpheres, buildStats.buildTime, buildStats.nodeCount, buildStats.maxDepth, nBVHRays,
+			bruteRate, soaRate, bvhRate, bvhRate / bruteRate, mismatches);
+		std::printf("%10s avg nodes/ray: %.1f, avg sphere tests/ray: %.1f, SAH cost: %.2f\n", "",
+			(double)traversalStats.nodesVisited / traversalStats.rays,
+			(double)traversalStats.spheresTested / traversalStats.rays,
+			buildStats.sahCost);
+
+		std::vector<RayPacket> packets = MakePrimaryPackets(scene, 512, 512);
+		const size_t nPrimaryRays = packets.size() * RayPacket::maxSize;
+
+		std::vector<int> singleHits(nPrimaryRays);
+		const double singleMs = MeasureMs([&] {
+			for (size_t p = 0; p < packets.size(); ++p) {
+				for (uint32_t i = 0; i < RayPacket::maxSize; ++i) {
+					Ray ray;
+					ray.origin = packets[p].origin;
+					ray.direction = { packets[p].directionX[i], packets[p].directionY[i], packets[p].directionZ[i] };
+					float hitDistance = std::numeric_limits<float>::max();
+					singleHits[p * RayPacket::maxSize + i] = bvh.Intersect(ray, hitDistance);
+				}
+			}
+		});
+
+		const double packetMs = MeasureMs([&] {
+			for (RayPacket& packet : packets) {
+				bvh.IntersectPacket(packet);
+			}
+		});
+
+		size_t packetMismatches = 0;
+		for (size_t p = 0; p < packets.size(); ++p) {
+			for (uint32_t i = 0; i < RayPacket::maxSize; ++i) {
+				if (packets[p].objectIndex[i] != singleHits[p * RayPacket::maxSize + i]) {
+					++packetMismatches;
+				}
+			}
+		}
+
+		std::printf("%10s primary rays: single %.3f Mray/s, 8x8 packet %.3f Mray/s (%.1fx), mismatch %zu\n", "",
+			nPrimaryRays / singleMs / 1000.0, nPrimaryRays / packetMs / 1000.0, singleMs / packetMs, packetMismatches);
+	}
+
+	return 0;
+}
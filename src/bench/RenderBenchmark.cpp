@@ -0,0 +1,481 @@
+// Reproducible performance suite over a fixed set of canonical scenes. For every
+// scene it measures the pieces TraceRay and ClosestHit are built from (BVH
+// queries, sphere tests, hit shading math), then full Renderer::Render frames:
+// Mrays/s, frame time percentiles and thread-scaling efficiency from 1 to N
+// threads. Prints a table and, with --json, writes the results for tracking
+// regressions across commits.
+// Usage: render_benchmark [--scenes a,b,...] [--width N] [--height N] [--frames N]
+//                         [--threads N] [--json results.json] [--label text]
+// Scenes: default, field10k, field1m, cluster, sky, lights   (default: all)
+
+#include "Renderer.h"
+#include "Framebuffer.h"
+#include "Camera.h"
+#include "SceneFile.h"
+#include "BVH.h"
+#include "SphereSoA.h"
+#include "Intersection.h"
+#include "VectorUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	struct BenchScene {
+		const char* name;
+		std::function<SceneDescription()> make;
+	};
+
+	struct MicroResult {
+		double traceNsPerRay = 0.0;
+		double nodesPerRay = 0.0;
+		double testsPerRay = 0.0;
+		double hitRate = 0.0;
+		double closestHitNs = 0.0; // hit position and normal, as ClosestHit computes them
+		double scalarNsPerTest = 0.0; // Utils::IntersectSphere
+		double soaNsPerTest = 0.0; // SphereSoA, per ray-sphere pair
+	};
+
+	struct ScalingPoint {
+		uint32_t threads;
+		double medianMs;
+		double efficiency; // t(1) / (threads * t(threads))
+	};
+
+	struct FrameResult {
+		uint32_t threads = 0;
+		double mraysPerSecond = 0.0;
+		double minMs = 0.0, p50Ms = 0.0, p90Ms = 0.0, p99Ms = 0.0, maxMs = 0.0;
+		std::vector<ScalingPoint> scaling;
+	};
+
+	std::vector<Material> MakeMaterials(std::mt19937& rng, size_t count)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<Material> materials(count);
+		for (Material& material : materials) {
+			material.Albedo = { unit(rng), unit(rng), unit(rng), 1.0f };
+			material.Roughness = unit(rng);
+		}
+		return materials;
+	}
+
+	// Uniform random spheres in a cube, at the density bvh_benchmark uses, seen from outside.
+	SceneDescription MakeField(size_t nSpheres)
+	{
+		std::mt19937 rng(1337u);
+		const float extent = 10.0f * std::cbrt((float)nSpheres / 1000.0f);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> radius(0.05f, 0.4f);
+		std::uniform_int_distribution<int> material(0, 7);
+
+		SceneDescription description;
+		description.scene.materials = MakeMaterials(rng, 8);
+		description.scene.spheres.resize(nSpheres);
+		for (Sphere& sphere : description.scene.spheres) {
+			sphere.position = { position(rng), position(rng), position(rng) };
+			sphere.radius = radius(rng);
+			sphere.materialIndex = material(rng);
+		}
+		description.cameraPosition = { 0.0f, 0.0f, -2.5f * extent };
+		description.cameraDirection = { 0.0f, 0.0f, 1.0f };
+		return description;
+	}
+
+	// Heavily overlapping spheres packed in a ball that fills the view: deep
+	// traversal and many candidate tests per ray.
+	SceneDescription MakeCluster()
+	{
+		std::mt19937 rng(4242u);
+		std::normal_distribution<float> offset(0.0f, 0.6f);
+		std::uniform_real_distribution<float> radius(0.02f, 0.15f);
+		std::uniform_int_distribution<int> material(0, 7);
+
+		SceneDescription description;
+		description.scene.materials = MakeMaterials(rng, 8);
+		description.scene.spheres.resize(20000);
+		for (Sphere& sphere : description.scene.spheres) {
+			sphere.position = { offset(rng), offset(rng), offset(rng) };
+			sphere.radius = radius(rng);
+			sphere.materialIndex = material(rng);
+		}
+		description.cameraPosition = { 0.0f, 0.0f, -4.0f };
+		return description;
+	}
+
+	// A handful of spheres low in the frame; almost every primary ray misses.
+	SceneDescription MakeSky()
+	{
+		std::mt19937 rng(7u);
+		SceneDescription description;
+		description.scene.materials = MakeMaterials(rng, 4);
+		for (int i = 0; i < 16; ++i) {
+			Sphere sphere;
+			sphere.position = { (float)(i % 4) * 1.5f - 2.25f, 2.5f, (float)(i / 4) * 1.5f };
+			sphere.radius = 0.3f;
+			sphere.materialIndex = i % 4;
+			description.scene.spheres.push_back(sphere);
+		}
+		description.cameraPosition = { 0.0f, 0.0f, -6.0f };
+		description.cameraDirection = { 0.0f, -0.05f, 1.0f };
+		return description;
+	}
+
+	// Thousands of small emitters over a ground plane, like windows at night:
+	// light selection decides whether a shadow ray finds anything.
+	SceneDescription MakeLights()
+	{
+		std::mt19937 rng(2024u);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		SceneDescription description;
+		description.scene.materials = MakeMaterials(rng, 4);
+		for (int i = 0; i < 4; ++i) {
+			Material& emitter = description.scene.materials.emplace_back();
+			const float strength = 20.0f + 80.0f * unit(rng);
+			emitter.Emission = { strength, strength * (0.6f + 0.4f * unit(rng)), strength * (0.3f + 0.7f * unit(rng)) };
+		}
+
+		Sphere ground;
+		ground.position = { 0.0f, 1001.0f, 0.0f };
+		ground.radius = 1000.0f;
+		description.scene.spheres.push_back(ground);
+		for (int i = 0; i < 64; ++i) {
+			Sphere sphere;
+			sphere.position = { unit(rng) * 40.0f - 20.0f, 0.0f, unit(rng) * 40.0f };
+			sphere.radius = 0.5f + unit(rng) * 0.5f;
+			sphere.position.y = 1.0f - sphere.radius;
+			sphere.materialIndex = i % 4;
+			description.scene.spheres.push_back(sphere);
+		}
+		for (int i = 0; i < 4096; ++i) {
+			Sphere sphere;
+			sphere.position = { unit(rng) * 40.0f - 20.0f, -unit(rng) * 3.0f, unit(rng) * 40.0f };
+			sphere.radius = 0.02f + unit(rng) * 0.03f;
+			sphere.materialIndex = 4 + i % 4;
+			description.scene.spheres.push_back(sphere);
+		}
+		description.cameraPosition = { 0.0f, -2.0f, -6.0f };
+		description.cameraDirection = { 0.0f, 0.15f, 1.0f };
+		return description;
+	}
+
+	std::vector<BenchScene> MakeScenes()
+	{
+		return {
+			{ "default", [] { return DefaultSceneDescription(); } },
+			{ "field10k", [] { return MakeField(10000); } },
+			{ "field1m", [] { return MakeField(1000000); } },
+			{ "cluster", [] { return MakeCluster(); } },
+			{ "sky", [] { return MakeSky(); } },
+			{ "lights", [] { return MakeLights(); } },
+		};
+	}
+
+	template<typename F>
+	double MeasureMs(F&& f)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		f();
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	// Nearest-rank percentile of an unsorted sample.
+	double Percentile(std::vector<double> values, double p)
+	{
+		std::sort(values.begin(), values.end());
+		const size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+		return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+	}
+
+	// Primary rays through random sub-pixel positions of the scene's camera.
+	std::vector<Ray> MakeCameraRays(const Camera& camera, int width, int height, size_t count)
+	{
+		std::mt19937 rng(99u);
+		std::uniform_real_distribution<float> x(0.0f, (float)width);
+		std::uniform_real_distribution<float> y(0.0f, (float)height);
+
+		std::vector<Ray> rays(count);
+		XMFLOAT3 origin;
+		XMStoreFloat3(&origin, camera.GetPosition());
+		for (Ray& ray : rays) {
+			ray.origin = origin;
+			ray.direction = camera.GetRayGenerator().GetDirection(x(rng), y(rng));
+		}
+		return rays;
+	}
+
+	MicroResult RunMicro(const SceneDescription& description, const Camera& camera, int width, int height)
+	{
+		const Scene& scene = description.scene;
+		MicroResult result;
+		volatile float sink = 0.0f;
+
+		BVH bvh;
+		bvh.Build(scene);
+		const std::vector<Ray> rays = MakeCameraRays(camera, width, height, 1u << 18);
+
+		std::vector<int> hits(rays.size());
+		std::vector<float> distances(rays.size());
+		BVH::TraversalStats stats;
+		bvh.Intersect(rays[0], distances[0], &stats); // warm-up
+		stats = {};
+		const double traceMs = MeasureMs([&] {
+			for (size_t i = 0; i < rays.size(); ++i) {
+				distances[i] = std::numeric_limits<float>::max();
+				hits[i] = bvh.Intersect(rays[i], distances[i], &stats);
+			}
+		});
+		result.traceNsPerRay = traceMs * 1e6 / rays.size();
+		result.nodesPerRay = (double)stats.nodesVisited / stats.rays;
+		result.testsPerRay = (double)stats.spheresTested / stats.rays;
+
+		size_t nHits = 0;
+		XMFLOAT3 normalSum = { 0.0f, 0.0f, 0.0f };
+		const double shadeMs = MeasureMs([&] {
+			for (size_t i = 0; i < rays.size(); ++i) {
+				if (hits[i] < 0) {
+					continue;
+				}
+				const Sphere& sphere = scene.spheres[hits[i]];
+				const XMFLOAT3 origin = Utils::Subtract(rays[i].origin, sphere.position);
+				const XMFLOAT3 position = Utils::Add(origin, Utils::Scale(rays[i].direction, distances[i]));
+				const XMFLOAT3 normal = Utils::Normalize(position);
+				const XMFLOAT3 reflected = Utils::Reflect(rays[i].direction, normal);
+				normalSum = Utils::Add(normalSum, Utils::Add(normal, reflected));
+				++nHits;
+			}
+		});
+		sink = sink + normalSum.x;
+		result.hitRate = (double)nHits / rays.size();
+		result.closestHitNs = nHits > 0 ? shadeMs * 1e6 / nHits : 0.0;
+
+		// Ray-sphere tests against the first spheres of the scene, scalar and SIMD.
+		const size_t nTestSpheres = std::min<size_t>(scene.spheres.size(), 1024);
+		const size_t nTestRays = std::max<size_t>(1, (1u << 22) / nTestSpheres);
+		const std::vector<Sphere> testSpheres(scene.spheres.begin(), scene.spheres.begin() + nTestSpheres);
+		const double scalarMs = MeasureMs([&] {
+			float nearest = 0.0f;
+			for (size_t i = 0; i < nTestRays; ++i) {
+				for (const Sphere& sphere : testSpheres) {
+					nearest += Utils::IntersectSphere(rays[i % rays.size()], sphere);
+				}
+			}
+			sink = sink + nearest;
+		});
+		result.scalarNsPerTest = scalarMs * 1e6 / ((double)nTestRays * nTestSpheres);
+
+		SphereSoA soa;
+		soa.Build(testSpheres);
+		const double soaMs = MeasureMs([&] {
+			int closest = 0;
+			for (size_t i = 0; i < nTestRays; ++i) {
+				float hitDistance = std::numeric_limits<float>::max();
+				closest += soa.Intersect(rays[i % rays.size()], hitDistance);
+			}
+			sink = sink + (float)closest;
+		});
+		result.soaNsPerTest = soaMs * 1e6 / ((double)nTestRays * nTestSpheres);
+		return result;
+	}
+
+	// Steady-state accumulation: every frame traces one sample for every pixel.
+	std::vector<double> RenderFrames(Renderer& renderer, const SceneDescription& description, const Camera& camera,
+		Framebuffer& framebuffer, uint32_t threads, int nFrames, uint64_t& rays)
+	{
+		Renderer::Settings& settings = renderer.GetSettings();
+		settings.threadCount = (int)threads;
+		renderer.ResetFrameIndex();
+		renderer.Render(framebuffer, description.scene, camera); // BVH build and warm-up
+
+		std::vector<double> times;
+		rays = 0;
+		for (int frame = 0; frame < nFrames; ++frame) {
+			renderer.Render(framebuffer, description.scene, camera);
+			times.push_back(renderer.GetLastRenderTime());
+			rays += renderer.GetLastRayCount();
+		}
+		return times;
+	}
+
+	FrameResult RunFrames(Renderer& renderer, const SceneDescription& description, int width, int height, int nFrames, uint32_t maxThreads)
+	{
+		Camera camera(width, height, description.verticalFov, 0.1f, 100.0f);
+		camera.SetPose(description.cameraPosition, description.cameraDirection);
+		Framebuffer framebuffer(width, height);
+		renderer.Resize(width, height);
+
+		FrameResult result;
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+			threadCounts.push_back(threads);
+		}
+		threadCounts.push_back(maxThreads);
+
+		double singleThreadMs = 0.0;
+		for (uint32_t threads : threadCounts) {
+			uint64_t rays = 0;
+			const std::vector<double> times = RenderFrames(renderer, description, camera, framebuffer, threads, nFrames, rays);
+			const double medianMs = Percentile(times, 50.0);
+			if (threads == 1) {
+				singleThreadMs = medianMs;
+			}
+			result.scaling.push_back({ threads, medianMs, singleThreadMs / (threads * medianMs) });
+
+			if (threads == maxThreads) {
+				double totalMs = 0.0;
+				for (double time : times) {
+					totalMs += time;
+				}
+				result.threads = threads;
+				result.mraysPerSecond = rays / totalMs / 1000.0;
+				result.minMs = Percentile(times, 0.0);
+				result.p50Ms = medianMs;
+				result.p90Ms = Percentile(times, 90.0);
+				result.p99Ms = Percentile(times, 99.0);
+				result.maxMs = Percentile(times, 100.0);
+			}
+		}
+		return result;
+	}
+
+	std::string JsonString(const std::string& s)
+	{
+		std::string quoted = "\"";
+		for (char c : s) {
+			if (c == '"' || c == '\\') {
+				quoted += '\\';
+			}
+			quoted += (unsigned char)c < 0x20 ? ' ' : c;
+		}
+		return quoted + "\"";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int width = 640;
+	int height = 360;
+	int nFrames = 32;
+	uint32_t maxThreads = ThreadPool::HardwareThreadCount();
+	std::string sceneList;
+	const char* jsonPath = nullptr;
+	std::string label;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = i + 1 < argc;
+		const std::string option = argv[i];
+		if (hasValue && option == "--scenes") {
+			sceneList = "," + std::string(argv[++i]) + ",";
+		}
+		else if (hasValue && option == "--width") {
+			width = std::atoi(argv[++i]);
+		}
+		else if (hasValue && option == "--height") {
+			height = std::atoi(argv[++i]);
+		}
+		else if (hasValue && option == "--frames") {
+			nFrames = std::atoi(argv[++i]);
+		}
+		else if (hasValue && option == "--threads") {
+			maxThreads = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		}
+		else if (hasValue && option == "--json") {
+			jsonPath = argv[++i];
+		}
+		else if (hasValue && option == "--label") {
+			label = argv[++i];
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--scenes a,b,...] [--width N] [--height N] [--frames N] [--threads N] [--json file] [--label text]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (width <= 0 || height <= 0 || nFrames <= 0) {
+		std::fprintf(stderr, "width, height and frames must be positive\n");
+		return 1;
+	}
+
+	Renderer renderer(width, height);
+	Renderer::Settings& settings = renderer.GetSettings();
+	settings.accumulate = true;
+	settings.adaptive = false;
+	settings.reduceResolution = false;
+	settings.reproject = false;
+
+	std::string json = "{\n  \"label\": " + JsonString(label) + ",\n";
+	char buffer[512];
+	std::snprintf(buffer, sizeof(buffer), "  \"simdWidth\": %u, \"hardwareThreads\": %u, \"width\": %d, \"height\": %d, \"frames\": %d,\n  \"scenes\": [\n",
+		SphereSoA::simdWidth, ThreadPool::HardwareThreadCount(), width, height, nFrames);
+	json += buffer;
+
+	std::printf("SIMD width %u, %ux%u, %d frames, up to %u threads\n", SphereSoA::simdWidth, width, height, nFrames, maxThreads);
+	std::printf("%10s %9s %8s %8s %8s %8s %9s %9s %10s %8s %8s %8s %8s\n",
+		"scene", "spheres", "trace ns", "nodes", "tests", "shade ns", "scalar ns", "soa ns",
+		"Mray/s", "p50 ms", "p90 ms", "p99 ms", "scaling");
+
+	bool first = true;
+	for (const BenchScene& benchScene : MakeScenes()) {
+		if (!sceneList.empty() && sceneList.find("," + std::string(benchScene.name) + ",") == std::string::npos) {
+			continue;
+		}
+		const SceneDescription description = benchScene.make();
+		Camera camera(width, height, description.verticalFov, 0.1f, 100.0f);
+		camera.SetPose(description.cameraPosition, description.cameraDirection);
+
+		const MicroResult micro = RunMicro(description, camera, width, height);
+		const FrameResult frames = RunFrames(renderer, description, width, height, nFrames, maxThreads);
+		const ScalingPoint& widest = frames.scaling.back();
+
+		std::printf("%10s %9zu %8.1f %8.1f %8.1f %8.1f %9.2f %9.2f %10.2f %8.2f %8.2f %8.2f %7.0f%%\n",
+			benchScene.name, description.scene.spheres.size(), micro.traceNsPerRay, micro.nodesPerRay, micro.testsPerRay,
+			micro.closestHitNs, micro.scalarNsPerTest, micro.soaNsPerTest,
+			frames.mraysPerSecond, frames.p50Ms, frames.p90Ms, frames.p99Ms, widest.efficiency * 100.0);
+
+		std::snprintf(buffer, sizeof(buffer),
+			"%s    { \"name\": \"%s\", \"spheres\": %zu,\n"
+			"      \"micro\": { \"traceNsPerRay\": %.3f, \"nodesPerRay\": %.3f, \"testsPerRay\": %.3f, \"hitRate\": %.4f, "
+			"\"closestHitNs\": %.3f, \"scalarNsPerTest\": %.4f, \"soaNsPerTest\": %.4f },\n",
+			first ? "" : ",\n", benchScene.name, description.scene.spheres.size(), micro.traceNsPerRay, micro.nodesPerRay,
+			micro.testsPerRay, micro.hitRate, micro.closestHitNs, micro.scalarNsPerTest, micro.soaNsPerTest);
+		json += buffer;
+		std::snprintf(buffer, sizeof(buffer),
+			"      \"frame\": { \"threads\": %u, \"mraysPerSecond\": %.3f, \"minMs\": %.3f, \"p50Ms\": %.3f, \"p90Ms\": %.3f, \"p99Ms\": %.3f, \"maxMs\": %.3f },\n"
+			"      \"scaling\": [",
+			frames.threads, frames.mraysPerSecond, frames.minMs, frames.p50Ms, frames.p90Ms, frames.p99Ms, frames.maxMs);
+		json += buffer;
+		for (size_t i = 0; i < frames.scaling.size(); ++i) {
+			std::snprintf(buffer, sizeof(buffer), "%s{ \"threads\": %u, \"medianMs\": %.3f, \"efficiency\": %.4f }",
+				i == 0 ? " " : ", ", frames.scaling[i].threads, frames.scaling[i].medianMs, frames.scaling[i].efficiency);
+			json += buffer;
+		}
+		json += " ] }";
+		first = false;
+
+		for (const ScalingPoint& point : frames.scaling) {
+			std::printf("%10s %9s %2u threads: %8.2f ms, efficiency %5.1f%%\n", "", "", point.threads, point.medianMs, point.efficiency * 100.0);
+		}
+	}
+	json += "\n  ]\n}\n";
+
+	if (jsonPath) {
+		FILE* file = std::fopen(jsonPath, "wb");
+		if (!file || std::fwrite(json.data(), 1, json.size(), file) != json.size() || std::fclose(file) != 0) {
+			std::fprintf(stderr, "failed to write %s\n", jsonPath);
+			return 1;
+		}
+	}
+	return 0;
+}
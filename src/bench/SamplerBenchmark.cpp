@@ -0,0 +1,168 @@
+// Compares the samplers PerPixel can use on analytic integrands over its
+// dimension layout: a 2D jitter, then ten dimensions per bounce (BSDF direction
+// pair and lobe, roulette, light cone pair and choice, one unused, environment
+// pair), drawn four bounces deep with the same Get1D/Get2D/Get3D calls. Reports
+// the RMSE of the per-pixel estimate against the exact value, then the RMSE each
+// sampler reaches in the time the independent sampler needs for its samples.
+// Usage: sampler_benchmark [samples per pixel]   (default: 256)
+
+#include "Sampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t imageSize = 64;
+	// As in Renderer: primaryDimensions and dimensionsPerBounce.
+	constexpr uint32_t primaryDimensions = 2;
+	constexpr uint32_t dimensionsPerBounce = 10;
+	constexpr uint32_t bounces = 4;
+	constexpr uint32_t dimensions = primaryDimensions + bounces * dimensionsPerBounce;
+	constexpr double pi = 3.14159265358979323846;
+
+	// Offsets of a bounce's dimensions, relative to its first.
+	constexpr uint32_t bsdfDirection = 0;
+	constexpr uint32_t bsdfLobe = 2;
+	constexpr uint32_t roulette = 3;
+	constexpr uint32_t lightCone = 4;
+	constexpr uint32_t environment = 8;
+
+	constexpr uint32_t Bounce(uint32_t bounce, uint32_t offset)
+	{
+		return primaryDimensions + bounce * dimensionsPerBounce + offset;
+	}
+
+	struct Integrand {
+		const char* name;
+		std::function<double(const float*)> f;
+		double exact;
+	};
+
+	std::vector<Integrand> MakeIntegrands()
+	{
+		return {
+			{ "smooth (jitter and every BSDF pair, 10D)", [](const float* u) {
+				double value = (1.0 + 0.5 * std::cos(2.0 * pi * u[0])) * (1.0 + 0.5 * std::cos(2.0 * pi * u[1]));
+				for (uint32_t b = 0; b < bounces; ++b) {
+					value *= 1.0 + 0.5 * std::cos(2.0 * pi * u[Bounce(b, bsdfDirection)]);
+					value *= 1.0 + 0.5 * std::cos(2.0 * pi * u[Bounce(b, bsdfDirection) + 1]);
+				}
+				return value;
+			}, 1.0 },
+			{ "BSDF pair and lobe in a sphere (3D)", [](const float* u) {
+				const float* v = &u[Bounce(0, bsdfDirection)];
+				return v[0] * v[0] + v[1] * v[1] + v[2] * v[2] < 1.0f ? 1.0 : 0.0;
+			}, pi / 6.0 },
+			{ "light cones at bounces 0 and 3 (4D)", [](const float* u) {
+				const float* first = &u[Bounce(0, lightCone)];
+				const float* last = &u[Bounce(bounces - 1, lightCone)];
+				return (first[0] + first[1] < 1.0f ? 1.0 : 0.0) * (last[0] + last[1] < 1.0f ? 1.0 : 0.0);
+			}, 0.25 },
+			{ "roulette survives every bounce (4D)", [](const float* u) {
+				double value = 1.0;
+				for (uint32_t b = 0; b < bounces; ++b) {
+					value *= u[Bounce(b, roulette)] < 0.7f ? 1.0 : 0.0;
+				}
+				return value;
+			}, 0.7 * 0.7 * 0.7 * 0.7 },
+		};
+	}
+
+	// One sample's dimensions, drawn with the calls PerPixel makes.
+	void Draw(const Sampler& sampler, const Sampler::PixelKey& pixel, uint32_t sampleIndex, float* u)
+	{
+		const DirectX::XMFLOAT2 jitter = sampler.Get2D(pixel, sampleIndex, 0);
+		u[0] = jitter.x;
+		u[1] = jitter.y;
+		for (uint32_t b = 0; b < bounces; ++b) {
+			float* v = &u[Bounce(b, 0)];
+			const DirectX::XMFLOAT3 bsdf = sampler.Get3D(pixel, sampleIndex, Bounce(b, bsdfDirection));
+			v[bsdfDirection] = bsdf.x;
+			v[bsdfDirection + 1] = bsdf.y;
+			v[bsdfLobe] = bsdf.z;
+			v[roulette] = sampler.Get1D(pixel, sampleIndex, Bounce(b, roulette));
+			const DirectX::XMFLOAT3 light = sampler.Get3D(pixel, sampleIndex, Bounce(b, lightCone));
+			v[lightCone] = light.x;
+			v[lightCone + 1] = light.y;
+			v[lightCone + 2] = light.z;
+			v[lightCone + 3] = 0.0f;
+			const DirectX::XMFLOAT2 env = sampler.Get2D(pixel, sampleIndex, Bounce(b, environment));
+			v[environment] = env.x;
+			v[environment + 1] = env.y;
+		}
+	}
+
+	// RMSE over all pixels of the nSamples estimate, and the time spent drawing samples.
+	double Measure(const Sampler& sampler, const Integrand& integrand, uint32_t nSamples, double& seconds)
+	{
+		double squaredError = 0.0;
+		seconds = 0.0;
+		std::vector<float> u(nSamples * dimensions);
+		for (uint32_t y = 0; y < imageSize; ++y) {
+			for (uint32_t x = 0; x < imageSize; ++x) {
+				const Sampler::PixelKey pixel = { x, y, x + y * imageSize };
+
+				const auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t s = 0; s < nSamples; ++s) {
+					Draw(sampler, pixel, s, &u[s * dimensions]);
+				}
+				seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+				double sum = 0.0;
+				for (uint32_t s = 0; s < nSamples; ++s) {
+					sum += integrand.f(&u[s * dimensions]);
+				}
+				const double error = sum / nSamples - integrand.exact;
+				squaredError += error * error;
+			}
+		}
+		return std::sqrt(squaredError / (imageSize * imageSize));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t nSamples = argc > 1 ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : 256u;
+	const Sampler::Type types[] = { Sampler::Type::Independent, Sampler::Type::Sobol, Sampler::Type::Halton, Sampler::Type::BlueNoise };
+
+	std::vector<std::unique_ptr<Sampler>> samplers;
+	for (Sampler::Type type : types) {
+		samplers.push_back(Sampler::Create(type));
+	}
+
+	for (const Integrand& integrand : MakeIntegrands()) {
+		std::printf("%s, %ux%u pixels\n", integrand.name, imageSize, imageSize);
+		std::printf("%24s %10s %10s %10s %10s %12s %10s %12s\n",
+			"sampler", "rmse@4", "rmse@16", "rmse@64", "rmse@N", "ns/sample", "equal-N", "equal-rmse");
+
+		double budget = 0.0;
+		for (size_t i = 0; i < samplers.size(); ++i) {
+			double rmse[4];
+			double seconds = 0.0;
+			const uint32_t counts[4] = { 4u, 16u, 64u, nSamples };
+			for (int c = 0; c < 4; ++c) {
+				rmse[c] = Measure(*samplers[i], integrand, counts[c], seconds);
+			}
+			const double perSample = seconds / ((double)nSamples * imageSize * imageSize);
+			if (i == 0) {
+				budget = seconds;
+			}
+
+			// Samples this sampler affords in the independent sampler's time.
+			const uint32_t equalCount = std::max(1u, (uint32_t)(budget / (perSample * imageSize * imageSize)));
+			double equalSeconds = 0.0;
+			const double equalRmse = Measure(*samplers[i], integrand, equalCount, equalSeconds);
+
+			std::printf("%24s %10.5f %10.5f %10.5f %10.5f %12.1f %10u %12.5f\n",
+				Sampler::GetName(types[i]), rmse[0], rmse[1], rmse[2], rmse[3], perSample * 1e9, equalCount, equalRmse);
+		}
+		std::printf("\n");
+	}
+	return 0;
+}
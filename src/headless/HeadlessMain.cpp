@@ -0,0 +1,288 @@
+// Batch renderer: renders scenes to a fixed sample count without a window or a
+// graphics device, writes linear PFM and display-referred PNG images, and prints
+// timing and ray throughput for every job as JSON on stdout.
+// Usage: raytracer_headless [--threads N] [--jobs file] [--stats file] [--trace file] [--cost] [job options]
+// Job options: [--scene file] [--width N] [--height N] [--samples N] [--output base]
+// --output base writes base.pfm and base.png. A jobs file holds one job per line,
+// written as job options; the command line ones are the defaults for every line.
+// --stats file appends every frame's RenderStats to file as one JSON line.
+// --trace file records a timeline of every render stage and tile and saves it as
+// Chrome trace JSON; each thread keeps its most recent events.
+// --cost also writes base.cost.pfm: mean sphere tests, bounces and nanoseconds per
+// sample in red, green and blue. Primary rays are then traced one at a time.
+
+#include "Renderer.h"
+#include "Framebuffer.h"
+#include "Camera.h"
+#include "SceneFile.h"
+#include "ImageIO.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Job {
+		std::string scene; // empty: the app's default scene
+		int width = 1280;
+		int height = 720;
+		int samples = 64;
+		std::string output; // empty: no images
+	};
+
+	struct JobResult {
+		double wallTime = 0.0; // s, scene load to images written
+		double renderTime = 0.0; // s, inside Renderer::Render
+		uint64_t rays = 0;
+		std::vector<std::string> outputs;
+	};
+
+	constexpr const char* usage =
+		"usage: %s [--threads N] [--jobs file] [--stats file] [--trace file] [--cost] [--scene file] [--width N] [--height N] [--samples N] [--output base]\n";
+
+	// Applies job options from args[i] on; returns false on an unknown option or a missing value.
+	bool ParseJobOption(const std::vector<std::string>& args, size_t& i, Job& job)
+	{
+		if (i + 1 >= args.size()) {
+			return false;
+		}
+		const std::string& option = args[i];
+		const std::string& value = args[++i];
+		if (option == "--scene") {
+			job.scene = value;
+		}
+		else if (option == "--width") {
+			job.width = std::atoi(value.c_str());
+		}
+		else if (option == "--height") {
+			job.height = std::atoi(value.c_str());
+		}
+		else if (option == "--samples") {
+			job.samples = std::atoi(value.c_str());
+		}
+		else if (option == "--output") {
+			job.output = value;
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	bool ReadJobs(const char* path, const Job& defaults, std::vector<Job>& jobs)
+	{
+		std::ifstream file(path);
+		if (!file) {
+			std::fprintf(stderr, "failed to open %s\n", path);
+			return false;
+		}
+		std::string line;
+		for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+			std::istringstream tokens(line.substr(0, line.find('#')));
+			std::vector<std::string> args;
+			for (std::string token; tokens >> token;) {
+				args.push_back(token);
+			}
+			if (args.empty()) {
+				continue;
+			}
+			Job job = defaults;
+			for (size_t i = 0; i < args.size(); ++i) {
+				if (!ParseJobOption(args, i, job)) {
+					std::fprintf(stderr, "%s:%d: bad job option '%s'\n", path, lineNumber, args[i].c_str());
+					return false;
+				}
+			}
+			jobs.push_back(job);
+		}
+		return true;
+	}
+
+	std::string JsonString(const std::string& s)
+	{
+		std::string quoted = "\"";
+		for (char c : s) {
+			switch (c) {
+			case '"': quoted += "\\\""; break;
+			case '\\': quoted += "\\\\"; break;
+			case '\n': quoted += "\\n"; break;
+			case '\t': quoted += "\\t"; break;
+			default:
+				if ((unsigned char)c < 0x20) {
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+					quoted += escaped;
+				}
+				else {
+					quoted += c;
+				}
+			}
+		}
+		return quoted + "\"";
+	}
+
+	bool RenderJob(Renderer& renderer, const Job& job, size_t jobIndex, size_t nJobs, FILE* statsFile, JobResult& result)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		SceneDescription description;
+		try {
+			description = job.scene.empty() ? DefaultSceneDescription() : LoadSceneDescription(job.scene);
+		}
+		catch (const std::exception& e) {
+			std::fprintf(stderr, "%s\n", e.what());
+			return false;
+		}
+
+		Camera camera(job.width, job.height, description.verticalFov, 0.1f, 100.0f);
+		camera.SetPose(description.cameraPosition, description.cameraDirection);
+		Framebuffer framebuffer(job.width, job.height);
+
+		// Every job starts from an empty accumulation buffer and, being a new scene,
+		// a fresh BVH; the renderer, and with it the worker threads, lives across jobs.
+		renderer.Resize(job.width, job.height);
+
+		for (int sample = 0; sample < job.samples; ++sample) {
+			renderer.Render(framebuffer, description.scene, camera);
+			result.renderTime += renderer.GetLastRenderTime() / 1000.0;
+			result.rays += renderer.GetLastRayCount();
+			if (statsFile) {
+				std::fprintf(statsFile, "{ \"job\": %zu, \"stats\": %s }\n", jobIndex, renderer.GetLastFrameStats().ToJson().c_str());
+			}
+			std::fprintf(stderr, "\rjob %zu/%zu: %d/%d spp", jobIndex + 1, nJobs, sample + 1, job.samples);
+		}
+		std::fprintf(stderr, "\n");
+
+		if (!job.output.empty()) {
+			PROFILE_ZONE("Write images");
+			renderer.ResolveRadiance(framebuffer);
+			const std::string pfm = job.output + ".pfm";
+			const std::string png = job.output + ".png";
+			if (!ImageIO::WritePFM(pfm.c_str(), framebuffer) || !ImageIO::WritePNG(png.c_str(), framebuffer)) {
+				std::fprintf(stderr, "failed to write %s.{pfm,png}\n", job.output.c_str());
+				return false;
+			}
+			result.outputs = { pfm, png };
+
+			if (renderer.GetSettings().collectCost) {
+				renderer.ResolveCost(framebuffer);
+				const std::string cost = job.output + ".cost.pfm";
+				if (!ImageIO::WritePFM(cost.c_str(), framebuffer)) {
+					std::fprintf(stderr, "failed to write %s\n", cost.c_str());
+					return false;
+				}
+				result.outputs.push_back(cost);
+			}
+		}
+
+		result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Job defaults;
+	int nThreads = 0;
+	std::string jobsPath;
+	std::string statsPath;
+	std::string tracePath;
+	bool collectCost = false;
+
+	const std::vector<std::string> args(argv + 1, argv + argc);
+	for (size_t i = 0; i < args.size(); ++i) {
+		const bool hasValue = i + 1 < args.size();
+		if (hasValue && args[i] == "--threads") {
+			nThreads = std::atoi(args[++i].c_str());
+		}
+		else if (hasValue && args[i] == "--jobs") {
+			jobsPath = args[++i];
+		}
+		else if (hasValue && args[i] == "--stats") {
+			statsPath = args[++i];
+		}
+		else if (hasValue && args[i] == "--trace") {
+			tracePath = args[++i];
+		}
+		else if (args[i] == "--cost") {
+			collectCost = true;
+		}
+		else if (!ParseJobOption(args, i, defaults)) {
+			std::fprintf(stderr, usage, argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Job> jobs;
+	if (!jobsPath.empty()) {
+		if (!ReadJobs(jobsPath.c_str(), defaults, jobs)) {
+			return 1;
+		}
+	}
+	else {
+		jobs.push_back(defaults);
+	}
+	for (const Job& job : jobs) {
+		if (job.width <= 0 || job.height <= 0 || job.samples <= 0) {
+			std::fprintf(stderr, "width, height and samples must be positive\n");
+			return 1;
+		}
+	}
+
+	// Plain accumulation: every Render adds exactly one sample to every pixel.
+	Renderer renderer(jobs.front().width, jobs.front().height);
+	Renderer::Settings& settings = renderer.GetSettings();
+	settings.threadCount = nThreads;
+	settings.accumulate = true;
+	settings.antiAliasing = true;
+	settings.adaptive = false;
+	settings.reduceResolution = false;
+	settings.reproject = false;
+	settings.collectCost = collectCost;
+
+	FILE* statsFile = nullptr;
+	if (!statsPath.empty() && !(statsFile = std::fopen(statsPath.c_str(), "w"))) {
+		std::fprintf(stderr, "failed to open %s\n", statsPath.c_str());
+		return 1;
+	}
+
+	Profiler::SetThreadName("Main");
+	Profiler::SetRecording(!tracePath.empty());
+
+	std::printf("[\n");
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		const Job& job = jobs[i];
+		JobResult result;
+		if (!RenderJob(renderer, job, i, jobs.size(), statsFile, result)) {
+			return 1;
+		}
+
+		std::string outputs;
+		for (const std::string& output : result.outputs) {
+			outputs += (outputs.empty() ? "" : ", ") + JsonString(output);
+		}
+		std::printf("  { \"scene\": %s, \"width\": %d, \"height\": %d, \"samples\": %d, \"threads\": %u, "
+			"\"wallTime\": %.6f, \"renderTime\": %.6f, \"rays\": %llu, \"raysPerSecond\": %.0f, \"outputs\": [%s] }%s\n",
+			JsonString(job.scene.empty() ? "default" : job.scene).c_str(), job.width, job.height, job.samples, renderer.GetThreadCount(),
+			result.wallTime, result.renderTime, (unsigned long long)result.rays,
+			result.renderTime > 0.0 ? (double)result.rays / result.renderTime : 0.0, outputs.c_str(), i + 1 < jobs.size() ? "," : "");
+		std::fflush(stdout);
+	}
+	std::printf("]\n");
+	if (statsFile) {
+		std::fclose(statsFile);
+	}
+	if (!tracePath.empty() && !Profiler::WriteChromeTrace(tracePath.c_str())) {
+		std::fprintf(stderr, "failed to write %s\n", tracePath.c_str());
+		return 1;
+	}
+	return 0;
+}